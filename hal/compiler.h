@@ -24,6 +24,9 @@
 
 	// placement (ram/rom/etc */
 	#define at_symbol(sym) __attribute__((section(sym)))        // place a object (ie struct var etc) at a position in code
+	#define at_ccm at_symbol(".ccm_data")                       // place initialised data in the core coupled ram (not reachable by dma)
+	#define at_ccm_bss at_symbol(".ccm_bss")                    // place zeroed data in the core coupled ram (not reachable by dma)
+	#define ramfunc at_symbol(".ramfunc")                      // run this function from ram (see the .ramfunc section of the linker scripts)
 
 	// inlining
 	#define force_inline __forceinline                          // force this function to inline
@@ -34,6 +37,15 @@
 	// unused object (don't warn)
 	#define unused __attribute__((unused))
 
+	// number of leading zero bits in a 32bit word (undefined for 0)
+	#define count_leading_zeros(x) __clz(x)
+
+	// exclusive access (ldrex/strex) for lock free updates, store_exclusive returns 0 on success
+	#define load_exclusive(addr) __ldrex(addr)
+	#define store_exclusive(addr, value) __strex(value, addr)
+	#define clear_exclusive() __clrex()
+	#define memory_barrier() __dmb(0xf)
+
 #elif (__GNUC__)
 	/* gcc compiler */
 
@@ -44,6 +56,13 @@
 
 	// placement (ram/rom/etc */
 	#define at_symbol(sym) __attribute__((section(sym)))            // place a object (ie struct var etc) at a position in code
+	#define at_ccm at_symbol(".ccm_data")                           // place initialised data in the core coupled ram (not reachable by dma)
+	#define at_ccm_bss at_symbol(".ccm_bss")                        // place zeroed data in the core coupled ram (not reachable by dma)
+	#if defined(__arm__) && (!defined(RAMFUNC) || RAMFUNC)
+	#define ramfunc __attribute__((section(".ramfunc"), long_call, noinline)) // run this function from ram (see the .ramfunc section of the linker scripts)
+	#else
+	#define ramfunc                                                 // RAMFUNC=0 (or a host build) leaves it in flash
+	#endif
 
 	// inlining
 	#define force_inline __attribute__((always_inline))             // force this function to inline
@@ -54,6 +73,41 @@
 	// unused object (don't warn)
 	#define unused __attribute__((unused))
 
+	// number of leading zero bits in a 32bit word (undefined for 0)
+	#define count_leading_zeros(x) __builtin_clz(x)
+
+	// exclusive access (ldrex/strex) for lock free updates, store_exclusive returns 0 on success
+	#if defined(__arm__)
+	static inline uint32_t load_exclusive(volatile uint32_t *addr)
+	{
+		uint32_t value;
+		__asm volatile ("ldrex %0, [%1]" : "=r" (value) : "r" (addr) : "memory");
+		return value;
+	}
+	static inline uint32_t store_exclusive(volatile uint32_t *addr, uint32_t value)
+	{
+		uint32_t failed;
+		__asm volatile ("strex %0, %2, [%1]" : "=&r" (failed) : "r" (addr), "r" (value) : "memory");
+		return failed;
+	}
+	#define clear_exclusive() __asm volatile ("clrex" ::: "memory")
+	#define memory_barrier() __asm volatile ("dmb" ::: "memory")
+	#else
+	// host builds (unit tests etc) have no exclusive monitor, a compare and swap
+	// against the value seen by the last load_exclusive does the same job
+	static uint32_t exclusive_value unused;
+	static inline uint32_t load_exclusive(volatile uint32_t *addr)
+	{
+		return exclusive_value = __atomic_load_n(addr, __ATOMIC_SEQ_CST);
+	}
+	static inline uint32_t store_exclusive(volatile uint32_t *addr, uint32_t value)
+	{
+		return !__atomic_compare_exchange_n(addr, &exclusive_value, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	}
+	#define clear_exclusive()
+	#define memory_barrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+	#endif
+
 #elif (__IAR_SYSTEMS_ICC__)
 	/* iar compiler */
 
@@ -64,6 +118,9 @@
 
 	// placement (ram/rom/etc)
 	#define at_symbol(sym) @ sym                                    // place a object (ie struct var etc) at a position in code (not available yet)
+	#define at_ccm at_symbol(".ccm_data")                           // place initialised data in the core coupled ram (not reachable by dma)
+	#define at_ccm_bss at_symbol(".ccm_bss")                        // place zeroed data in the core coupled ram (not reachable by dma)
+	#define ramfunc __ramfunc                                      // run this function from ram
 
 	// inlining
 	#define force_inline                                            // not supported
@@ -74,6 +131,15 @@
 	///@todo unused object (don't warn)
 	#define unused 
 
+	// number of leading zero bits in a 32bit word (undefined for 0, needs intrinsics.h)
+	#define count_leading_zeros(x) __CLZ(x)
+
+	// exclusive access (ldrex/strex) for lock free updates, store_exclusive returns 0 on success (needs intrinsics.h)
+	#define load_exclusive(addr) __LDREX((unsigned long *)(addr))
+	#define store_exclusive(addr, value) __STREX(value, (unsigned long *)(addr))
+	#define clear_exclusive() __CLREX()
+	#define memory_barrier() __DMB()
+
 #endif
 
 
@@ -145,6 +145,27 @@ uint32_t sys_clk_freq(void)
 }
 
 
+// the f107x cmsis has no DWT definitions
+#define DWT_CTRL (*(volatile uint32_t *)0xe0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xe0001004)
+#define DWT_CTRL_CYCCNTENA (1)
+
+
+// start the DWT cycle counter
+static void sys_cycles_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+
+uint32_t sys_get_cycles(void)
+{
+	return DWT_CYCCNT;
+}
+
+
 // setup the tick handler interrupt rate
 static void sys_tick_init()
 {
@@ -303,6 +324,7 @@ void sys_init(void)
 	sys_clk_init();
 	sys_interrupt_init();
 	sys_tick_init();
+	sys_cycles_init();
 	sys_temp_init();
 	sys_log_init();
 
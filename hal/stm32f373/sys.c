@@ -148,6 +148,21 @@ uint32_t sys_clk_freq(void)
 }
 
 
+// start the DWT cycle counter
+static void sys_cycles_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+uint32_t sys_get_cycles(void)
+{
+	return DWT->CYCCNT;
+}
+
+
 // setup the tick handler interrupt rate
 static void sys_tick_init()
 {
@@ -306,6 +321,7 @@ void sys_init(void)
 	sys_clk_init();
 	sys_interrupt_init();
 	sys_tick_init();
+	sys_cycles_init();
 	sys_temp_init();
 	sys_log_init();
 }
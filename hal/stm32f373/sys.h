@@ -41,6 +41,32 @@ void sys_enter_critical_section(void);
 void sys_leave_critical_section(void);
 
 
+/**
+ * ceiling the drivers and the scheduler lock at (see sys_lock)
+ */
+#ifndef SYS_LOCK_KERNEL
+#define SYS_LOCK_KERNEL (1)
+#endif
+
+typedef uint32_t sys_lock_t;
+
+
+/**
+ * @brief lock out the isrs that call into mos (the scheduler locks with this)
+ * @param ceiling highest preemption priority to mask, this hal has no priority
+ * ceilings so it is ignored and the lock is a critical section
+ * @return value to pass to sys_unlock
+ */
+#define sys_lock(ceiling) (sys_enter_critical_section(), (sys_lock_t)0)
+
+
+/**
+ * @brief undo a sys_lock
+ * @param lock the value the matching sys_lock returned
+ */
+#define sys_unlock(lock) ((void)(lock), sys_leave_critical_section())
+
+
 /**
  * @brief return the system clock frequency
  * @return system clock frequency in Hz
@@ -48,6 +74,15 @@ void sys_leave_critical_section(void);
 uint32_t sys_clk_freq(void);
 
 
+/**
+ * @brief get the cpu cycle count (the DWT cycle counter)
+ * @note this wraps every ~60s at 72MHz, take differences of unsigned counts to time
+ * things (see sys_clk_freq to convert to time)
+ * @return the number of cpu cycles since sys_init
+ */
+uint32_t sys_get_cycles(void);
+
+
 /**
  * @brief get the number of 1ms intervals since boot
  * @note there is not attempt to deal with rollovers in this function
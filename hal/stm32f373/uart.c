@@ -267,17 +267,18 @@ void uart_set_read_timeout(uart_t *uart, float timeout)
 }
 
 
-void uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param)
+int uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param)
 {
+	int ret = -1;
+
 	// sanity checks
 	if (len < 1)
-		///@todo invalid input parameters
-		return;
+		return -1;
 
 	sys_enter_critical_section();   // lock while changing things so an isr does not find a half setup read
 
 	if (uart->read_buf != NULL || uart->read_count != 0)
-		///@todo read in progress already
+		// read in progress already
 		goto done;
 
 	// load the read info
@@ -309,10 +310,11 @@ void uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb,
 	}
 	else
 		USART_ITConfig(uart->channel, USART_IT_RXNE, ENABLE);
+	ret = 0;
 
 done:
 	sys_leave_critical_section();
-	return;
+	return ret;
 }
 
 
@@ -337,17 +339,18 @@ void uart_cancel_read(uart_t *uart)
 }
 
 
-void uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param)
+int uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param)
 {
+	int ret = -1;
+
 	// sanity checks
 	if (len < 1)
-		///@todo invalid input parameters
-		return;
+		return -1;
 
 	sys_enter_critical_section();   // lock while changing things so an isr does not find a half setup write
 
 	if (uart->write_buf != NULL || uart->write_count != 0)
-		///@todo write in progress already
+		// write in progress already
 		goto done;
 
 	// load the write info
@@ -371,10 +374,11 @@ void uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb
 	}
 	else
 		USART_ITConfig(uart->channel, USART_IT_TXE, ENABLE);
+	ret = 0;
 
 done:
 	sys_leave_critical_section();
-	return;
+	return ret;
 }
 
 
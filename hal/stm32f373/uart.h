@@ -51,8 +51,10 @@ typedef void (*uart_write_complete_cb)(uart_t *uart, void *buf, uint16_t len, vo
  * @param len number of bytes in the buffer
  * @param cb completion callback
  * @param param parameter passed to the completion callback
+ * @return 0 if the write was started, -1 if it wasn't (len is 0 or a write is already in progress)
+ * and cb will not be called
  */
-void uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param);
+int uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param);
 
 
 /**
@@ -86,8 +88,10 @@ typedef void (*uart_read_complete_cb)(uart_t *uart, void *buf, uint16_t len, voi
  * @param len number of bytes in the buffer
  * @param cb completion callback
  * @param param parameter passed to the completion callback
+ * @return 0 if the read was started, -1 if it wasn't (len is 0 or a read is already in progress)
+ * and cb will not be called
  */
-void uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param);
+int uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param);
 
 
 /**
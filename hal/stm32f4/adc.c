@@ -10,6 +10,8 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_ADC
+
 #include <stm32f4xx_conf.h>
 #include "hal.h"
 #include "gpio_hw.h"
@@ -108,8 +110,9 @@ static void adc_dma_complete(dma_request_t *req, void *param)
 	adc_t * adc = ch->adc;
 	adc_trace_complete_t cb;
 	int count;
+	sys_lock_t lock;
 
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	// if we are in circular mode just keep going
 	if (!adc->dma->circ)
@@ -133,7 +136,7 @@ static void adc_dma_complete(dma_request_t *req, void *param)
 		ADC_ClearFlag(adc->base, ADC_FLAG_OVR);
 	}
 
-	sys_leave_critical_section();
+	sys_unlock(lock);
 
 	if (req->dma->isr_status & 0x20)
 		count = ch->count;
@@ -155,6 +158,7 @@ static void adc_dma_complete(dma_request_t *req, void *param)
 void adc_trace(adc_channel_t *ch, uint16_t *dst, int count, int trigger, adc_trace_complete_t cb, void *param)
 {
 	adc_t *adc = ch->adc;
+	sys_lock_t lock;
 	ADC_InitTypeDef init =
 	{
 		.ADC_Resolution = ADC_Resolution_12b,
@@ -163,7 +167,7 @@ void adc_trace(adc_channel_t *ch, uint16_t *dst, int count, int trigger, adc_tra
 		.ADC_NbrOfConversion = 1,
 	};
 
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	// setup dma
 	if (adc->dma == NULL)
@@ -178,7 +182,14 @@ void adc_trace(adc_channel_t *ch, uint16_t *dst, int count, int trigger, adc_tra
 	adc->dma_req.complete_param = ch;
 	adc->dma_req.dma = adc->dma;
 	adc_dma_cfg(adc, &adc->dma_req, (void *)dst, count);
-	dma_request(&adc->dma_req);
+	if (dma_request(&adc->dma_req) != 0)
+	{
+		// the dma can't reach dst (ie it is in the ccm), complete with nothing read
+		sys_unlock(lock);
+		if (cb != NULL)
+			cb(ch, dst, 0, param);
+		return;
+	}
 	ADC_DMACmd(adc->base, ENABLE);
 
 	// setup the trigger that keeps the adc running count times, if no trigger is given
@@ -206,7 +217,7 @@ void adc_trace(adc_channel_t *ch, uint16_t *dst, int count, int trigger, adc_tra
 	ADC_RegularChannelConfig(adc->base, ch->number, 1, ch->sample_time);
 
 done:
-	sys_leave_critical_section();
+	sys_unlock(lock);
 
 	// if we don't have a trigger start the adc manually
 	if (!trigger)
@@ -217,15 +228,16 @@ done:
 void adc_cancel_trace(adc_channel_t *ch)
 {
 	adc_t *adc = ch->adc;
+	sys_lock_t lock;
 
 	// cancel dma
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 	if (adc->dma == NULL)
 		///@todo error current implementation does not support interrupts so we need a dma
 		return;
 	ADC_DMACmd(adc->base, DISABLE);
 	dma_cancel(adc->dma); // cancel any pending/running dma
-	sys_leave_critical_section();
+	sys_unlock(lock);
 }
 
 
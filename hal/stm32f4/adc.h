@@ -27,6 +27,8 @@ typedef struct adc_channel_t adc_channel_t;
  * @param trigger 0 start now, 1 honour any trigger setup in hw.c
  * @param cb call this once count samples have been read into dst
  * @param param pass this to cb on completion
+ * @note dst can't be in the ccm or on the main stack as the dma has no path to it,
+ * cb is called straight away with count 0
  */
 typedef void (*adc_trace_complete_t)(adc_channel_t *ch, uint16_t *dst, int count, void *param);
 void adc_trace(adc_channel_t *ch, uint16_t *dst, int count, int trigger, adc_trace_complete_t cb, void *param);
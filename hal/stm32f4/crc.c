@@ -10,6 +10,8 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_CRC
+
 #include <crc.h>
 #include <stm32f4xx_conf.h>
 #include "hal.h"
@@ -64,9 +66,10 @@ bool cm_t_compare(const cm_t *a, const cm_t *b)
 uint32_t crc_buf_hard(struct crc_h *h, const void *buf, uint32_t len, bool reset)
 {
 	uint32_t r; 
+	sys_lock_t lock;
 
 	// crc hw is a shared resource so we need to lock around it
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	// reset
 	if (reset)
@@ -82,19 +85,21 @@ uint32_t crc_buf_hard(struct crc_h *h, const void *buf, uint32_t len, bool reset
 	r = CRC_CalcBlockCRC((uint32_t *)buf, len);
 
 	// return result
-	sys_leave_critical_section();
+	sys_unlock(lock);
 	return r;
 }
 
 
 bool crc_init_hard(struct crc_h *h)
 {
+	sys_lock_t lock;
+
 	// if the cm config matches the hardware we are good to go !!
 	if (!cm_t_compare(&h->cm, &stm32f4_crc_h.cm))
 		return false;
 
 	// crc hw is a shared resource so we need to lock around it
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	// start crc hw clock if needed
 	if (!clk_running)
@@ -103,7 +108,7 @@ bool crc_init_hard(struct crc_h *h)
 
 	// do initial reset
 	CRC_ResetDR();
-	sys_leave_critical_section();
+	sys_unlock(lock);
 
 	// mark as hard
 	h->method = CRC_METHOD_HARD;
@@ -14,8 +14,8 @@
 #include "dma_hw.h"
 
 
-static dma_t *dma1_irq_list[8] = {NULL,};
-static dma_t *dma2_irq_list[8] = {NULL,};
+static dma_t *dma1_irq_list[8] at_ccm_bss = {NULL,};
+static dma_t *dma2_irq_list[8] at_ccm_bss = {NULL,};
 
 static unsigned int dma_irq(dma_t *dma)
 {
@@ -153,7 +153,9 @@ static void dma_clear_isr(dma_t *dma)
 	}
 }
 
-static void dma_irq_handler(dma_t *dma)
+// the handlers are in ram and go to the registers rather than the st library
+// (which is in flash), the flags are cleared the same way they are read
+static ramfunc void dma_irq_handler(dma_t *dma)
 {
 	dma_request_t *req;
 
@@ -164,222 +166,237 @@ static void dma_irq_handler(dma_t *dma)
 	req = dma->reqs;
 	if (!dma->circ)
 	{
-		DMA_ITConfig(dma->stream, DMA_IT_TC, DISABLE);
-		DMA_ITConfig(dma->stream, DMA_IT_HT, DISABLE);
-		DMA_Cmd(dma->stream, DISABLE);
+		dma->stream->CR &= ~(DMA_SxCR_TCIE | DMA_SxCR_HTIE | DMA_SxCR_EN);
 		dma->reqs = NULL; // free the dma before complete so complete can sched another
 	}
 
+	trace(TRACE_DMA_DONE, trace_obj(dma));
 	if (req->complete != NULL)
 		req->complete(req, req->complete_param);
 }
 
-void DMA1_Stream0_IRQHandler(void)
+ramfunc void DMA1_Stream0_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[0];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->LISR >> 0) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF0);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF0);
+		DMA1->LIFCR = 0x30 << 0;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA1_Stream1_IRQHandler(void)
+ramfunc void DMA1_Stream1_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[1];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->LISR >> 6) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF1);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF1);
+		DMA1->LIFCR = 0x30 << 6;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA1_Stream2_IRQHandler(void)
+ramfunc void DMA1_Stream2_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[2];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->LISR >> 16) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF2);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF2);
+		DMA1->LIFCR = 0x30 << 16;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA1_Stream3_IRQHandler(void)
+ramfunc void DMA1_Stream3_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[3];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->LISR >> 22) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF3);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF3);
+		DMA1->LIFCR = 0x30 << 22;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA1_Stream4_IRQHandler(void)
+ramfunc void DMA1_Stream4_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[4];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->HISR >> 0) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF4);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF4);
+		DMA1->HIFCR = 0x30 << 0;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA1_Stream5_IRQHandler(void)
+ramfunc void DMA1_Stream5_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[5];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->HISR >> 6) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF5);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF5);
+		DMA1->HIFCR = 0x30 << 6;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA1_Stream6_IRQHandler(void)
+ramfunc void DMA1_Stream6_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[6];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->HISR >> 16) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF6);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF6);
+		DMA1->HIFCR = 0x30 << 16;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA1_Stream7_IRQHandler(void)
+ramfunc void DMA1_Stream7_IRQHandler(void)
 {
 	dma_t *dma = dma1_irq_list[7];
+	trace_isr_enter();
 	dma->isr_status = (DMA1->HISR >> 22) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF7);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF7);
+		DMA1->HIFCR = 0x30 << 22;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream0_IRQHandler(void)
+ramfunc void DMA2_Stream0_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[0];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->LISR >> 0) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF0);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF0);
+		DMA2->LIFCR = 0x30 << 0;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream1_IRQHandler(void)
+ramfunc void DMA2_Stream1_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[1];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->LISR >> 6) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF1);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF1);
+		DMA2->LIFCR = 0x30 << 6;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream2_IRQHandler(void)
+ramfunc void DMA2_Stream2_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[2];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->LISR >> 16) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF2);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF2);
+		DMA2->LIFCR = 0x30 << 16;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream3_IRQHandler(void)
+ramfunc void DMA2_Stream3_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[3];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->LISR >> 22) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF3);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF3);
+		DMA2->LIFCR = 0x30 << 22;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream4_IRQHandler(void)
+ramfunc void DMA2_Stream4_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[4];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->HISR >> 0) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF4);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF4);
+		DMA2->HIFCR = 0x30 << 0;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream5_IRQHandler(void)
+ramfunc void DMA2_Stream5_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[5];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->HISR >> 6) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF5);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF5);
+		DMA2->HIFCR = 0x30 << 6;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream6_IRQHandler(void)
+ramfunc void DMA2_Stream6_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[6];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->HISR >> 16) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF6);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF6);
+		DMA2->HIFCR = 0x30 << 16;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
-void DMA2_Stream7_IRQHandler(void)
+ramfunc void DMA2_Stream7_IRQHandler(void)
 {
 	dma_t *dma = dma2_irq_list[7];
+	trace_isr_enter();
 	dma->isr_status = (DMA2->HISR >> 22) & 0x3f;
 
 	if (dma->isr_status & 0x30)
 	{
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_TCIF7);
-		DMA_ClearITPendingBit(dma->stream, DMA_IT_HTIF7);
+		DMA2->HIFCR = 0x30 << 22;
 		dma_irq_handler(dma);
 	}
+	trace_isr_exit();
 }
 
 
@@ -424,17 +441,30 @@ void dma_memcpy(dma_t *dma, void *dst, void *src, int len, dma_memcpy_complete_e
 	req->st_dma_init.DMA_MemoryBurst = DMA_MemoryBurst_Single;
 	req->st_dma_init.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
 
-	dma_request(req);
+	// complete with nothing copied if the dma refuses (ie src or dst in the ccm)
+	if (dma_request(req) != 0 && complete != NULL)
+		complete(dma, dst, src, 0);
 }
 
-void dma_request(dma_request_t *req)
+// is an address in the ccm (see at_ccm)
+static int dma_in_ccm(uint32_t addr)
+{
+	return addr >= CCMDATARAM_BASE && addr < CCMDATARAM_BASE + 0x10000;
+}
+
+
+int dma_request(dma_request_t *req)
 {
 	dma_t *dma = req->dma;
 
 	///@todo queue a list of requests (for now just 1 at a time please)
 	if (dma->reqs != NULL)
-		///@todo error dma busy !
-		return;
+		return -1;
+
+	// the dma has no path to the ccm, refuse rather than read or write the wrong memory
+	if (dma_in_ccm(req->st_dma_init.DMA_Memory0BaseAddr) ||
+			(req->st_dma_init.DMA_DIR == DMA_DIR_MemoryToMemory && dma_in_ccm(req->st_dma_init.DMA_PeripheralBaseAddr)))
+		return -1;
 	dma->reqs = req;
 
 	dma_clear_isr(dma);
@@ -442,10 +472,12 @@ void dma_request(dma_request_t *req)
 	while (DMA_GetCmdStatus(dma->stream))
 	{}
 	DMA_Init(dma->stream, &req->st_dma_init);
+	trace(TRACE_DMA_START, trace_obj(dma));
 	DMA_ITConfig(dma->stream, DMA_IT_TC, ENABLE);
 	if (dma->circ)
 		DMA_ITConfig(dma->stream, DMA_IT_HT, ENABLE);
 	DMA_Cmd(dma->stream, ENABLE);
+	return 0;
 }
 
 int dma_remaining(dma_request_t *req)
@@ -503,7 +535,7 @@ void dma_init(dma_t *dma)
 
 	// enable nvic
 	NVIC_InitStructure.NVIC_IRQChannel = dma_irq(dma);
-	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = dma->preemption_priority;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = sys_isr_priority(dma->preemption_priority);
 	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
 	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&NVIC_InitStructure);
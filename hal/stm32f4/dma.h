@@ -22,6 +22,8 @@ typedef struct dma_t dma_t;
  * @param src source of memcpy
  * @param len number of bytes copied in the memcpy
  * @param complete call this when the memcpy is complete
+ * @note dst and src can't be in the ccm or on the main stack as the dma has no path to
+ * it, complete is called straight away with len 0 (and also if the dma is busy)
  */
 typedef void (*dma_memcpy_complete_event_t)(dma_t *dma, void *dst, void *src, int len);
 void dma_memcpy(dma_t *dma, void *dst, void *src, int len, dma_memcpy_complete_event_t complete);
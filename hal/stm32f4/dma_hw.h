@@ -26,7 +26,13 @@ struct dma_request_t
 	struct dma_t *dma;
 };
 
-void dma_request(dma_request_t *req);
+/**
+ * @brief start a dma request
+ * @param req request to start (req->complete is called when it is done)
+ * @return 0 if started, -1 if the dma is busy or a memory address is in the ccm
+ * (the dma has no path to it, see at_ccm), then req->complete is never called
+ */
+int dma_request(dma_request_t *req);
 
 int dma_remaining(dma_request_t *req);
 
@@ -218,7 +218,7 @@ static uint32_t gpio_pin_to_exti_irq(gpio_pin_t *pin)
 
 
 // save the pin into a list so it can be recalled in the isr's
-static gpio_pin_t *gpio_pin_irq_list[16] = {0,};
+static gpio_pin_t *gpio_pin_irq_list[16] at_ccm_bss = {0,};
 static void save_pin_for_irq(gpio_pin_t *pin)
 {
 	uint8_t index = 0;
@@ -282,21 +282,22 @@ static void save_pin_for_irq(gpio_pin_t *pin)
 }
 
 
-// handle all the edge events in this one place
-void exti_isr(uint8_t line_start, uint8_t line_end)
+// handle all the edge events in this one place (in ram with the handlers, so
+// it goes to the registers rather than the st library, EXTI_Linen is 1 << n)
+ramfunc void exti_isr(uint8_t line_start, uint8_t line_end)
 {
 	uint8_t l;
-	const uint32_t lines[] = {EXTI_Line0, EXTI_Line1, EXTI_Line2, EXTI_Line3, EXTI_Line4, EXTI_Line5, EXTI_Line6, EXTI_Line7, EXTI_Line8, EXTI_Line9, EXTI_Line10, EXTI_Line11, EXTI_Line12, EXTI_Line13, EXTI_Line14, EXTI_Line15};
+	uint32_t pending = EXTI->PR & EXTI->IMR;
 
 	// test all the lines that could have generated this irq if one is set, run the appropriate edge callback
 	for (l = line_start; l <= line_end; l++)
 	{
-		if (EXTI_GetITStatus(lines[l]) != RESET)
+		if (pending & (1 << l))
 		{
 			gpio_pin_t *pin = gpio_pin_irq_list[l];
 
 			// clear the irq for this line
-			EXTI_ClearITPendingBit(lines[l]);
+			EXTI->PR = 1 << l;
 
 			// if pin is valid, what type of edge was generated
 			if (pin != NULL)
@@ -323,45 +324,59 @@ void exti_isr(uint8_t line_start, uint8_t line_end)
 }
 
 
-void EXTI0_IRQHandler(void)
+ramfunc void EXTI0_IRQHandler(void)
 {
+	trace_isr_enter();
 	exti_isr(0, 0);
+	trace_isr_exit();
 }
 
 
-void EXTI1_IRQHandler(void)
+ramfunc void EXTI1_IRQHandler(void)
 {
+	trace_isr_enter();
 	exti_isr(1, 1);
+	trace_isr_exit();
 }
 
 
-void EXTI2_IRQHandler(void)
+ramfunc void EXTI2_IRQHandler(void)
 {
+	trace_isr_enter();
 	exti_isr(2, 2);
+	trace_isr_exit();
 }
 
 
-void EXTI3_IRQHandler(void)
+ramfunc void EXTI3_IRQHandler(void)
 {
+	trace_isr_enter();
 	exti_isr(3, 3);
+	trace_isr_exit();
 }
 
 
-void EXTI4_IRQHandler(void)
+ramfunc void EXTI4_IRQHandler(void)
 {
+	trace_isr_enter();
 	exti_isr(4, 4);
+	trace_isr_exit();
 }
 
 
-void EXTI9_5_IRQHandler(void)
+ramfunc void EXTI9_5_IRQHandler(void)
 {
+	trace_isr_enter();
 	exti_isr(5, 9);
+	trace_isr_exit();
 }
 
 
-void EXTI15_10_IRQHandler(void)
+ramfunc void EXTI15_10_IRQHandler(void)
 {
+	trace_isr_enter();
 	exti_isr(10, 15);
+	trace_isr_exit();
 }
 
 
@@ -393,7 +408,7 @@ static void gpio_set_edge_event(gpio_pin_t *pin, EXTITrigger_TypeDef trig, gpio_
 	// Enable and set EXTI9_5 Interrupt to the lowest priority
 	save_pin_for_irq(pin);  ///@todo this may need to warn if another pin is registered with this irq in case the caller forgets the pins share irq's
 	nvic_init.NVIC_IRQChannel = gpio_pin_to_exti_irq(pin);
-	nvic_init.NVIC_IRQChannelPreemptionPriority = pin->preemption_priority;
+	nvic_init.NVIC_IRQChannelPreemptionPriority = sys_isr_priority(pin->preemption_priority);
 	nvic_init.NVIC_IRQChannelSubPriority = 0x0F;
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&nvic_init);
@@ -26,7 +26,7 @@ struct gpio_pin_t
 	void *rising_cb_param;          ///< passed to rising cb
 	gpio_edge_event falling_cb;     ///< if not NULL thane called on falling edge
 	void *falling_cb_param;         ///< passed to falling cb
-	uint8_t preemption_priority;    ///< lower is a higher priority
+	uint8_t preemption_priority;    ///< lower is a higher priority (no higher than SYS_LOCK_KERNEL, see sys_isr_priority)
 	uint8_t pos;
 	uint8_t initialised;
 };
@@ -25,6 +25,8 @@
 #include "dma.h"
 #include "gpio.h"
 #include "uart.h"
+#include "log.h"
+#include "trace.h"
 #include "spis.h"
 #include "spim.h"
 #include "nvm.h"
@@ -33,7 +35,9 @@
 #include "adc.h"
 #include "tmr.h"
 #include "pwm.h"
+#include "hrtimer.h"
 #include "ppm.h"
+#include "prof.h"
 #include "usb.h"
 #include "i2c.h"
 #include "bootstrap.h"
@@ -0,0 +1,242 @@
+/**
+ * @file hrtimer.c
+ *
+ * @brief implement the hrtimer module for the stm32f4
+ *
+ * the parent timer free runs at 1MHz over its full 32bit range, a compare
+ * channel is set to the time of the earliest event and its isr runs all the
+ * due events and then sets the compare for the next one
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <stm32f4xx_conf.h>
+#include "hal.h"
+#include "tmr_hw.h"
+#include "hrtimer_hw.h"
+
+// the event list is shared with the tmr isr so lock at the kernel ceiling (the
+// tmr isr is at or below it), the masked time is counted against the hrtimer
+#define hrtimer_lock() sys_lock_module(SYS_LOCK_KERNEL, SYS_LOCK_HRTIMER)
+
+
+static void set_compare(hrtimer_t *hrt, uint32_t time)
+{
+	switch (hrt->ch)
+	{
+		case TIM_Channel_1:
+			TIM_SetCompare1(hrt->tmr->tim, time);
+			break;
+		case TIM_Channel_2:
+			TIM_SetCompare2(hrt->tmr->tim, time);
+			break;
+		case TIM_Channel_3:
+			TIM_SetCompare3(hrt->tmr->tim, time);
+			break;
+		case TIM_Channel_4:
+			TIM_SetCompare4(hrt->tmr->tim, time);
+			break;
+	}
+}
+
+
+// compare interrupt flag/event bit for the channel (TIM_IT_CCx and TIM_EGR_CCxG line up)
+static uint16_t compare_it(hrtimer_t *hrt)
+{
+	switch (hrt->ch)
+	{
+		case TIM_Channel_2:
+			return TIM_IT_CC2;
+		case TIM_Channel_3:
+			return TIM_IT_CC3;
+		case TIM_Channel_4:
+			return TIM_IT_CC4;
+		case TIM_Channel_1:
+		default:
+			return TIM_IT_CC1;
+	}
+}
+
+
+// add the event to the queue in time order (call from a critical section)
+static void insert_event(hrtimer_t *hrt, hrtimer_event_t *event)
+{
+	hrtimer_event_t **e;
+
+	for (e = &hrt->head; *e; e = &(*e)->next)
+		if (sys_tick_diff(event->time, (*e)->time) > 0)
+			break;
+
+	event->next = *e;
+	*e = event;
+	event->active = 1;
+}
+
+
+// take the event out of the queue (call from a critical section)
+static int remove_event(hrtimer_t *hrt, hrtimer_event_t *event)
+{
+	hrtimer_event_t **e;
+
+	for (e = &hrt->head; *e; e = &(*e)->next)
+	{
+		if (*e == event)
+		{
+			*e = event->next;
+			event->next = NULL;
+			event->active = 0;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+// set the compare for the earliest event, if it is already due (ie it was
+// added in the past or the compare was set too late to match) force the
+// compare event so the isr runs it straight away (call from a critical section)
+static void arm(hrtimer_t *hrt)
+{
+	TIM_TypeDef *tim = hrt->tmr->tim;
+	uint16_t it = compare_it(hrt);
+
+	if (hrt->head == NULL)
+	{
+		TIM_ITConfig(tim, it, DISABLE);
+		return;
+	}
+
+	set_compare(hrt, hrt->head->time);
+	TIM_ITConfig(tim, it, ENABLE);
+	if (sys_tick_diff(tim->CNT, hrt->head->time) <= 0)
+		tim->EGR = it;
+}
+
+
+// compare isr, run all the events that are due
+static void hrtimer_compare(tmr_t *tmr, int ch, void *param)
+{
+	hrtimer_t *hrt = (hrtimer_t *)param;
+	hrtimer_event_t *event;
+	uint32_t now = tmr->tim->CNT;
+
+	while ((event = hrt->head) && sys_tick_diff(now, event->time) <= 0)
+	{
+		hrt->head = event->next;
+		event->next = NULL;
+		event->active = 0;
+
+		if (event->period)
+		{
+			// re-arm from when it should have fired (not now) so it does not drift
+			event->time += event->period;
+			if (sys_tick_diff(now, event->time) <= 0)
+				// fallen a whole period behind, skip the missed periods
+				event->time += ((now - event->time) / event->period + 1) * event->period;
+			insert_event(hrt, event);
+		}
+
+		// the callback is free to cancel/restart this or any other event
+		event->cb(event, event->param);
+		now = tmr->tim->CNT;
+	}
+
+	arm(hrt);
+}
+
+
+uint32_t hrtimer_get_us(hrtimer_t *hrt)
+{
+	return hrt->tmr->tim->CNT;
+}
+
+
+void hrtimer_start_at(hrtimer_t *hrt, hrtimer_event_t *event, uint32_t time, uint32_t period, hrtimer_cb_t cb, void *param)
+{
+	sys_lock_t lock;
+
+	lock = hrtimer_lock();
+
+	if (event->active)
+		remove_event(hrt, event);
+	event->time = time;
+	event->period = period;
+	event->cb = cb;
+	event->param = param;
+	insert_event(hrt, event);
+
+	// only need to touch the compare if this is the new earliest event
+	if (hrt->head == event)
+		arm(hrt);
+
+	sys_unlock(lock);
+}
+
+
+void hrtimer_start(hrtimer_t *hrt, hrtimer_event_t *event, uint32_t delay, uint32_t period, hrtimer_cb_t cb, void *param)
+{
+	hrtimer_start_at(hrt, event, hrtimer_get_us(hrt) + delay, period, cb, param);
+}
+
+
+int hrtimer_cancel(hrtimer_t *hrt, hrtimer_event_t *event)
+{
+	int ret;
+	sys_lock_t lock;
+
+	lock = hrtimer_lock();
+	ret = remove_event(hrt, event);
+	if (ret)
+		// a stale compare match would just find nothing due, but save the isr
+		arm(hrt);
+	sys_unlock(lock);
+
+	return ret;
+}
+
+
+void hrtimer_init(hrtimer_t *hrt)
+{
+	tmr_t *tmr = hrt->tmr;
+	TIM_OCInitTypeDef oc_cfg;
+
+	hrt->head = NULL;
+
+	// init the parent timer and then take over its time base, the tmr module
+	// limits the period to 16bits so the full 32bit range is set up here
+	tmr_init(tmr);
+	TIM_TimeBaseStructInit(&tmr->cfg);
+	tmr->cfg.TIM_Period = UINT32_MAX;
+	tmr->cfg.TIM_Prescaler = tmr_get_clk_freq(tmr) / 1000000 - 1;
+	tmr->cfg.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(tmr->tim, &tmr->cfg);
+	tmr->arr = tmr->cfg.TIM_Period;
+	tmr->prescaler = tmr->cfg.TIM_Prescaler;
+
+	// the compare channel only generates the interrupt, it drives no pin
+	TIM_OCStructInit(&oc_cfg);
+	oc_cfg.TIM_OCMode = TIM_OCMode_Timing;
+	switch (hrt->ch)
+	{
+		case TIM_Channel_1:
+			TIM_OC1Init(tmr->tim, &oc_cfg);
+			break;
+		case TIM_Channel_2:
+			TIM_OC2Init(tmr->tim, &oc_cfg);
+			break;
+		case TIM_Channel_3:
+			TIM_OC3Init(tmr->tim, &oc_cfg);
+			break;
+		case TIM_Channel_4:
+			TIM_OC4Init(tmr->tim, &oc_cfg);
+			break;
+	}
+	tmr_set_compare_cb(tmr, hrtimer_compare, hrt->ch, hrt);
+	TIM_ITConfig(tmr->tim, compare_it(hrt), DISABLE);
+
+	tmr_start(tmr);
+}
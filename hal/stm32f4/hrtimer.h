@@ -0,0 +1,90 @@
+/**
+ * @file hrtimer.h
+ *
+ * @brief high resolution timer service, many one shot and periodic events with
+ * us resolution on one free running 32bit timer
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note the events are kept in a deadline sorted queue and the timer compare
+ * channel is re-programmed for the earliest one. Event callbacks run from the
+ * timer isr so keep them short (ie post a sched task for anything longer, see
+ * sched_post_from_isr). The events are owned by the caller so the service never
+ * allocates.
+ *
+ */
+
+
+#ifndef __HRTIMER__
+#define __HRTIMER__
+
+/**
+ * @brief opaque hrtimer (the timer and compare channel, see hrtimer_hw.h)
+ */
+typedef struct hrtimer_t hrtimer_t;
+
+
+/**
+ * @brief an event on a hrtimer, allocate one for each callback (the fields are
+ * managed by the hrtimer functions)
+ */
+typedef struct hrtimer_event_t hrtimer_event_t;
+typedef void (*hrtimer_cb_t)(hrtimer_event_t *event, void *param);
+struct hrtimer_event_t
+{
+	uint32_t time;					///< next time the event fires (us)
+	uint32_t period;				///< period in us or 0 for a one shot event
+	hrtimer_cb_t cb;
+	void *param;
+	uint8_t active;					///< the event is in the queue
+	hrtimer_event_t *next;
+};
+
+
+/**
+ * @brief get the free running us count of the timer
+ * @param hrt the hrtimer
+ * @return time in us (wraps every ~71 minutes, use sys_tick_diff to compare times)
+ */
+uint32_t hrtimer_get_us(hrtimer_t *hrt);
+
+
+/**
+ * @brief start an event at an absolute time
+ * @param hrt the hrtimer
+ * @param event the event to start (if it is already running it is restarted)
+ * @param time time to fire the event (according to hrtimer_get_us)
+ * @param period re-fire the event every period us (0 for a one shot event)
+ * @param cb callback run from the timer isr when the event fires
+ * @param param callback parameter
+ * @note periodic events are re-armed from the time they should have fired so they
+ * do not drift, if the cpu falls a whole period behind the missed periods are skipped
+ */
+void hrtimer_start_at(hrtimer_t *hrt, hrtimer_event_t *event, uint32_t time, uint32_t period, hrtimer_cb_t cb, void *param);
+
+
+/**
+ * @brief start an event a number of us from now
+ * @see hrtimer_start_at
+ */
+void hrtimer_start(hrtimer_t *hrt, hrtimer_event_t *event, uint32_t delay, uint32_t period, hrtimer_cb_t cb, void *param);
+
+
+/**
+ * @brief stop an event
+ * @param hrt the hrtimer
+ * @param event the event to stop
+ * @return 1 if the event was running, else 0
+ */
+int hrtimer_cancel(hrtimer_t *hrt, hrtimer_event_t *event);
+
+
+/**
+ * @brief inits the hrtimer and starts its timer counting in us
+ * @param hrt hrtimer to initialise
+ */
+void hrtimer_init(hrtimer_t *hrt);
+
+#endif
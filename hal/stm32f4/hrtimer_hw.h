@@ -0,0 +1,30 @@
+/**
+ * @file hrtimer_hw.h
+ *
+ * @brief this contains hw definitions for configuration via hw.c only (it is not a run time interface !)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HRTIMER_HW__
+#define __HRTIMER_HW__
+
+
+#include "hal.h"
+#include "tmr_hw.h"
+
+
+// internal representation of a hrtimer
+typedef struct hrtimer_t hrtimer_t;
+struct hrtimer_t
+{
+	tmr_t *tmr;						///< parent timer, this must be a 32bit timer (TIM2 or TIM5) and is fully owned by the hrtimer
+	uint16_t ch;					///< compare channel used for the events (TIM_Channel_1 .. TIM_Channel_4)
+
+	hrtimer_event_t *head;			///< events sorted by time
+};
+
+#endif
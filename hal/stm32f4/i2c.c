@@ -9,6 +9,8 @@
  *
  */
 
+#define SYS_LOCK_MODULE SYS_LOCK_I2C
+
 #include <stm32f4xx_conf.h>
 #include "hal.h"
 #include "gpio_hw.h"
@@ -48,7 +50,7 @@ int next_fr_entry = 0;
 #endif
 
 // Store the i2c handle so we can get it in the irq
-static i2c_t *i2c_irq_list[2] = {};
+static i2c_t *i2c_irq_list[2] at_ccm_bss = {};
 
 static uint8_t i2c_irq(i2c_t *i2c)
 {
@@ -106,6 +108,7 @@ static void i2c_rx_complete(i2c_t *i2c, int len)
 	void *param = i2c->cb_param;
 
 	i2c_clear_read(i2c);
+	trace(TRACE_I2C_READ_DONE, trace_obj(i2c));
 	if (read_complete_cb != NULL)
 	{
 		read_complete_cb(i2c, i2c->read_buf, len, param);
@@ -123,6 +126,7 @@ static void i2c_tx_complete(i2c_t *i2c, int len)
 	void *param = i2c->cb_param;
 
 	i2c_clear_write(i2c);
+	trace(TRACE_I2C_WRITE_DONE, trace_obj(i2c));
 	if (write_complete_cb)
 	{
 		write_complete_cb(i2c, i2c->write_buf, len, param);
@@ -142,6 +146,7 @@ static void i2c_error(i2c_t *i2c)
 
 	i2c_clear_write(i2c);
 	i2c_clear_read(i2c);
+	trace(TRACE_I2C_ERROR, trace_obj(i2c));
 	if (error_cb)
 	{
 		error_cb(i2c, i2c->error_code, param);
@@ -460,22 +465,30 @@ static void i2c_irq_handler(i2c_t *i2c)
 
 void I2C1_EV_IRQHandler(void)
 {
+	trace_isr_enter();
 	i2c_irq_handler(i2c_irq_list[0]);
+	trace_isr_exit();
 }
 
 void I2C2_EV_IRQHandler(void)
 {
+	trace_isr_enter();
 	i2c_irq_handler(i2c_irq_list[1]);
+	trace_isr_exit();
 }
 
 void I2C1_ER_IRQHandler(void)
 {
+	trace_isr_enter();
 	i2c_error_irq_handler(i2c_irq_list[0]);
+	trace_isr_exit();
 }
 
 void I2C2_ER_IRQHandler(void)
 {
+	trace_isr_enter();
 	i2c_error_irq_handler(i2c_irq_list[1]);
+	trace_isr_exit();
 }
 
 // Wait for the I2C bus to be not busy.
@@ -501,17 +514,19 @@ bool wait_for_i2c_bus(i2c_t *i2c)
 int i2c_read(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 		i2c_transfer_complete_cb cb, i2c_error_cb error_cb, void *param)
 {
+	sys_lock_t lock;
+
 	if (len < 1)
 	{
 		return -1;
 	}
 	// Make sure we are not interrupted
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	if (i2c_busy(i2c))
 	{
 		// The I2C driver is busy
-		sys_leave_critical_section();
+		sys_unlock(lock);
 		return -3;
 	}
 
@@ -521,7 +536,7 @@ int i2c_read(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 		if (!wait_for_i2c_bus(i2c))
 		{
 			// I2C bus busy timeout
-			sys_leave_critical_section();
+			sys_unlock(lock);
 			return -3;
 		}
 	}
@@ -541,6 +556,8 @@ int i2c_read(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 	}
 #endif
 
+	trace(TRACE_I2C_READ, trace_obj(i2c));
+
 	// Initialise the read info
 	i2c->read_buf_len = len;
 	i2c->read_buf = buf;
@@ -570,33 +587,37 @@ int i2c_read(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 		I2C_GenerateSTART(i2c->channel, ENABLE);
 	}
 
-	sys_leave_critical_section();
+	sys_unlock(lock);
 	return 0;
 }
 
 void i2c_cancel_read(i2c_t *i2c)
 {
-	sys_enter_critical_section();
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
 	i2c_clear_read(i2c);
 	i2c->state = I2C_STATE_IDLE;
-	sys_leave_critical_section();
+	sys_unlock(lock);
 
 }
 
 int i2c_write(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 		i2c_transfer_complete_cb cb, i2c_error_cb error_cb, void *param)
 {
+	sys_lock_t lock;
+
 	if (len < 1)
 	{
 		return -1;
 	}
 	// Make sure we are not interrupted
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	if (i2c_busy(i2c))
 	{
 		// The I2C driver is busy
-		sys_leave_critical_section();
+		sys_unlock(lock);
 		return -2;
 	}
 
@@ -606,7 +627,7 @@ int i2c_write(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 		if (!wait_for_i2c_bus(i2c))
 		{
 			// I2C bus busy timeout
-			sys_leave_critical_section();
+			sys_unlock(lock);
 			return -3;
 		}
 	}
@@ -626,6 +647,8 @@ int i2c_write(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 	}
 #endif
 
+	trace(TRACE_I2C_WRITE, trace_obj(i2c));
+
 	// Initialise the write info
 	i2c->write_buf_len = len;
 	i2c->write_buf = buf;
@@ -655,16 +678,18 @@ int i2c_write(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 		I2C_GenerateSTART(i2c->channel, ENABLE);
 	}
 
-	sys_leave_critical_section();
+	sys_unlock(lock);
 	return 0;
 }
 
 void i2c_cancel_write(i2c_t *i2c)
 {
-	sys_enter_critical_section();
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
 	i2c_clear_write(i2c);
 	i2c->state = I2C_STATE_IDLE;
-	sys_leave_critical_section();
+	sys_unlock(lock);
 }
 
 i2c_error_code_t i2c_last_error(i2c_t *i2c)
@@ -704,9 +729,8 @@ void i2c_init(i2c_t *i2c)
 	}
 
 	/* i2c isr */
-	NVIC_PriorityGroupConfig(NVIC_PriorityGroup_1);
 	NVIC_InitStructure.NVIC_IRQChannel = i2c_irq(i2c);
-	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = SYS_LOCK_KERNEL;
 	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
 	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&NVIC_InitStructure);
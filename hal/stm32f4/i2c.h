@@ -62,6 +62,8 @@ typedef void (*i2c_error_cb)(i2c_t *i2c, i2c_error_code_t error_code, void *para
  * @param error_cb error callback
  * @param param parameter passed to the completion callback
  * Note that the callbacks are called from the interrupt handler.
+ * The i2c is interrupt driven (no dma) so buf can be anywhere, including the
+ * ccm and the main stack (as long as it lasts until the callback).
  */
 int i2c_write(i2c_t *i2c, uint8_t device_address,void *buf, uint16_t len,
 		i2c_transfer_complete_cb cb, i2c_error_cb error_cb, void *param);
@@ -90,6 +92,7 @@ void i2c_clear_read(i2c_t *i2c);
  * @param error_cb error callback
  * @param param parameter passed to the completion callback
  * Note that the callbacks are called from the interrupt handler.
+ * As with i2c_write buf can be anywhere, including the ccm and the main stack.
  */
 int i2c_read(i2c_t *i2c, uint8_t device_address, void *buf, uint16_t len,
 		i2c_transfer_complete_cb cb, i2c_error_cb error_cb, void *param);
@@ -0,0 +1,174 @@
+/**
+ * @file log.c
+ *
+ * @brief implements the deferred binary log of the hal
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#define SYS_LOCK_MODULE SYS_LOCK_LOG
+
+#include <string.h>
+#include "hal.h"
+
+#define LOG_RING_MASK (LOG_RING_WORDS - 1)
+
+/* head and tail are free running word counts. A writer reserves its words by
+ * moving head on (with ldrex/strex so a writer at any isr priority can cut in)
+ * and writes the header word last, so a non zero header means the record is
+ * complete. The drain moves scan past the complete records and sends them
+ * straight out of the ring, they are zeroed once sent, before tail moves on */
+struct log_ring_t
+{
+	uint32_t buf[LOG_RING_WORDS];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	uint32_t scan;					// start of the first record not known to be complete
+	uint32_t sending;				// words in the running uart write (0 if there is none)
+	uart_t *uart;
+	struct log_stats_t stats;
+};
+static struct log_ring_t log_ring;
+
+
+void log_write(uint32_t header, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+	uint32_t argc = (header >> 16) & 0xff;
+	uint32_t head, n;
+
+	do
+	{
+		head = load_exclusive(&log_ring.head);
+		if (head + argc + 2 - log_ring.tail > LOG_RING_WORDS)
+		{
+			// full, drop the record rather than wait for the drain
+			clear_exclusive();
+			do
+			{
+				n = load_exclusive(&log_ring.stats.dropped);
+			} while (store_exclusive(&log_ring.stats.dropped, n + 1));
+			return;
+		}
+	} while (store_exclusive(&log_ring.head, head + argc + 2));
+
+	// a record can wrap round the end of the ring, the drain sends it in two parts
+	log_ring.buf[(head + 1) & LOG_RING_MASK] = sys_cycle_stamp();
+	switch (argc)
+	{
+	case 4:
+		log_ring.buf[(head + 5) & LOG_RING_MASK] = a3;
+	case 3:
+		log_ring.buf[(head + 4) & LOG_RING_MASK] = a2;
+	case 2:
+		log_ring.buf[(head + 3) & LOG_RING_MASK] = a1;
+	case 1:
+		log_ring.buf[(head + 2) & LOG_RING_MASK] = a0;
+	}
+
+	// the record has to be written before the header says it is complete
+	memory_barrier();
+	log_ring.buf[head & LOG_RING_MASK] = header;
+}
+
+
+void log_init(uart_t *uart)
+{
+	log_ring.uart = uart;
+}
+
+
+static void log_sent(uart_t *uart, void *buf, uint16_t len, void *param)
+{
+	// clear the headers before the space can be reserved again
+	memset(buf, 0, len);
+	log_ring.stats.sent += len;
+	log_ring.tail += len / sizeof(uint32_t);
+	log_ring.sending = 0;
+
+	// nothing sent means the uart couldn't send from the ring (see uart_write),
+	// draining again now would only fail the same way so leave it to the next drain
+	if (len == 0)
+	{
+		log_ring.stats.failed++;
+		return;
+	}
+
+	// keep sending while there is more
+	log_drain();
+}
+
+
+void log_drain(void)
+{
+	uint32_t tail, header, n;
+	sys_lock_t lock;
+
+	if (log_ring.uart == NULL)
+		return;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	if (log_ring.sending)
+		goto done;
+
+	// move scan past the complete records, stopping at one that is still being written
+	while (log_ring.scan != log_ring.head)
+	{
+		header = log_ring.buf[log_ring.scan & LOG_RING_MASK];
+		if (header >> 24 != LOG_SYNC)
+			break;
+		log_ring.scan += ((header >> 16) & 0xff) + 2;
+	}
+
+	// the uart sends a run of memory so stop at the end of the ring, the rest goes next time
+	tail = log_ring.tail;
+	n = log_ring.scan - tail;
+	if (n > LOG_RING_WORDS - (tail & LOG_RING_MASK))
+		n = LOG_RING_WORDS - (tail & LOG_RING_MASK);
+	if (n == 0)
+		goto done;
+
+	log_ring.sending = n;
+	if (uart_write(log_ring.uart, &log_ring.buf[tail & LOG_RING_MASK], n * sizeof(uint32_t), log_sent, NULL) != 0)
+	{
+		// the uart is busy with something else, try again on the next drain
+		log_ring.sending = 0;
+		log_ring.stats.failed++;
+	}
+
+done:
+	sys_unlock(lock);
+}
+
+
+uint32_t log_copy(uint32_t *buf, uint32_t words)
+{
+	uint32_t start = log_ring.tail, head = log_ring.head, header, k;
+
+	// skip the oldest records until the rest fit (stepping a word at a time
+	// over anything that isn't a complete record)
+	while ((int32_t)(head - start) > (int32_t)words)
+	{
+		header = log_ring.buf[start & LOG_RING_MASK];
+		if (header >> 24 == LOG_SYNC)
+			start += ((header >> 16) & 0xff) + 2;
+		else
+			start++;
+	}
+
+	for (k = 0; k < words && (int32_t)(head - start) > 0; k++, start++)
+		buf[k] = log_ring.buf[start & LOG_RING_MASK];
+	return k;
+}
+
+
+void log_get_stats(struct log_stats_t *stats)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	*stats = log_ring.stats;
+	sys_unlock(lock);
+}
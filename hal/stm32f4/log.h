@@ -0,0 +1,132 @@
+/**
+ * @file log.h
+ *
+ * @brief deferred binary log of the hal
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note sys_log does not format anything on the cpu. The format string is
+ * placed in the .mos_log section, which the linker scripts keep out of the
+ * image (it is only in the elf), and the offset of the string in that section
+ * is its id. A log call just writes the id, the cycle count and the raw
+ * arguments into a ring, which log_drain later sends out of a uart with dma,
+ * ie run it from a background task
+ *
+ *	log_init(&uart_dev);
+ *	sched_add_periodic(10, 0, SCHED_PRIORITIES - 1, log_drain, 0);
+ *	...
+ *	sys_log("adc %d took %u cycles", channel, cycles);
+ *
+ * and scripts/log_decode.py turns the uart output back into text with the
+ * format strings from the elf. Arguments are 32bit words, up to LOG_MAX_ARGS
+ * of them, so integers, chars and pointers can be logged as they are, floats
+ * have to be passed as log_float(x) and logged with %f, strings can't be
+ * logged (%s prints the pointer)
+ *
+ */
+
+#ifndef __LOG__
+#define __LOG__
+
+/**
+ * size of the log ring in 32bit words (a power of 2), a record is 2 words plus
+ * a word per argument
+ */
+#ifndef LOG_RING_WORDS
+#define LOG_RING_WORDS (512)
+#endif
+
+#define LOG_MAX_ARGS (4)
+
+/**
+ * a record starts with a header word, LOG_SYNC in the top byte, the number of
+ * arguments in the next byte and the format id in the low 16 bits. The cycle
+ * count is the next word and the arguments follow
+ */
+#define LOG_SYNC (0xa5)
+#define LOG_HEADER(id, argc) (((uint32_t)LOG_SYNC << 24) | ((uint32_t)(argc) << 16) | ((uint32_t)(uintptr_t)(id) & 0xffff))
+
+/**
+ * @brief log stats
+ */
+struct log_stats_t
+{
+	uint32_t dropped;		/**< records lost as the ring was full */
+	uint32_t sent;			/**< bytes sent out of the uart */
+	uint32_t failed;		/**< sends the uart refused or completed with nothing sent */
+};
+
+
+// number of arguments to sys_log (0 to LOG_MAX_ARGS)
+#define LOG_NARGS(...) LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+#define LOG_ARGS(...) LOG_ARGS_(0, ##__VA_ARGS__, 0, 0, 0, 0)
+#define LOG_ARGS_(_0, a, b, c, d, ...) (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d)
+
+
+/**
+ * @brief log a message (safe from any isr priority, it does not mask interrupts)
+ * @param fmt printf format string (a string literal)
+ * @param ... up to LOG_MAX_ARGS integer arguments
+ */
+#define sys_log(fmt, ...) \
+	do \
+	{ \
+		static const char log_fmt[] at_symbol(".mos_log") = fmt; \
+		log_write(LOG_HEADER(log_fmt, LOG_NARGS(__VA_ARGS__)), LOG_ARGS(__VA_ARGS__)); \
+	} while (0)
+
+
+/**
+ * @brief pass a float to sys_log (the bits are logged as they are)
+ */
+static inline uint32_t log_float(float f)
+{
+	union { float f; uint32_t u; } v = {f};
+	return v.u;
+}
+
+
+/**
+ * @brief write a record to the log ring (use sys_log)
+ * @param header record header (see LOG_HEADER)
+ * @param a0 .. a3 arguments, only the number in the header are logged
+ */
+void log_write(uint32_t header, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+
+/**
+ * @brief set the uart the log is sent out of
+ * @param uart uart device (already initialised, a tx dma is best so sending doesn't load the cpu)
+ * @note the uart is best kept for the log, a write from anything else holds the log back
+ * until the next log_drain after it completes (see log_stats_t failed)
+ */
+void log_init(uart_t *uart);
+
+
+/**
+ * @brief start sending the records written so far, does nothing if a send is
+ * already running (call it from a background task, it doesn't block)
+ */
+void log_drain(void);
+
+
+/**
+ * @brief copy the newest records that haven't been sent yet (for the crash dump,
+ * it doesn't lock or change the ring)
+ * @param buf where to copy them
+ * @param words size of buf in words
+ * @return number of words copied
+ */
+uint32_t log_copy(uint32_t *buf, uint32_t words);
+
+
+/**
+ * @brief get the log stats
+ * @param stats filled in with a copy of the stats
+ */
+void log_get_stats(struct log_stats_t *stats);
+
+#endif
@@ -14,22 +14,50 @@
 #include <string.h> // for memcpy (do this manually to remove dep)
 
 
+/* the flash can't be read while it is busy, so the code that runs while it is
+ * (the erase and the programming loop) is in ram (see ramfunc) and goes to the
+ * flash registers rather than the st library, it doesn't stall the cpu or fault
+ * on a read of the flash. They are only called in a critical section so no
+ * isr can run from the flash in the mean time */
+
+
+// wait for the last operation to finish, false if it failed
+static ramfunc bool flash_wait(void)
+{
+	while (FLASH->SR & FLASH_SR_BSY)
+		;
+
+	if (FLASH->SR & (FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR))
+		///todo error!
+		return false;
+
+	return true;
+}
+
+
+// erase the sector a word at a time (2.7 to 3.6v, see VoltageRange_3)
+static ramfunc bool flash_erase_sector(uint32_t sector)
+{
+	bool ret;
+
+	if (!flash_wait())
+		return false;
+
+	FLASH->CR = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SNB)) | FLASH_CR_PSIZE_1 | FLASH_CR_SER | (sector << 3);
+	FLASH->CR |= FLASH_CR_STRT;
+	ret = flash_wait();
+	FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+	return ret;
+}
+
+
 static bool erase(uint32_t sector)
 {
 	bool ret;
 	FLASH_Unlock();
 
-	switch (FLASH_EraseSector(sector << 3, VoltageRange_3))
-	{
-		case FLASH_COMPLETE:
-			ret = true;
-			break;
-
-		default:
-			///@todo error message
-			ret = false;
-			break;
-	}
+	///@todo error message if it fails
+	ret = flash_erase_sector(sector);
 
 	FLASH_Lock();
 	return ret;
@@ -92,51 +120,56 @@ bool nvm_read(void *dst, const void *src, uint32_t len)
 
 
 #define FLASH_WRITE_TIMEOUT 0x2000
-static bool flash_wait(void)
+static ramfunc bool flash_write_word(uint16_t *dst, uint16_t *src)
 {
-	FLASH_Status status = FLASH_BUSY;
+	bool ret;
 
-	while (status == FLASH_BUSY)
-		status = FLASH_WaitForLastOperation();
+	// check if the bytes already match then don't change them (I think we might even get an error)
+	if (*dst == *src)
+		return true;
 
-	if (status != FLASH_COMPLETE)
-		///todo error!
+	// write the word
+	FLASH->CR = (FLASH->CR & ~FLASH_CR_PSIZE) | FLASH_CR_PSIZE_0 | FLASH_CR_PG;
+	*(volatile uint16_t *)dst = *src;
+	ret = flash_wait();
+	FLASH->CR &= ~FLASH_CR_PG;
+	if (!ret)
+		///@todo error
 		return false;
 
+	// verify (now they should be the same)
+	if (*dst != *src)
+		///@todo verify error
+		return false;  // verification error
+
+	// success
 	return true;
 }
 
 
-static bool flash_write_word(uint16_t *dst, uint16_t *src)
+// the programming loop, in ram so it doesn't go back to the flash between words
+static ramfunc bool flash_write(uint16_t *dst, uint16_t *src, uint32_t len)
 {
-	// check if the bytes already match then don't change them (I think we might even get an error)
-	if (*dst == *src)
-		return true;
-
-	// write the word
-	switch (FLASH_ProgramHalfWord((uint32_t)dst, *src))
+	// write the bytes as 16bit words
+	while (len > 1)
 	{
-		case FLASH_COMPLETE:
-			// job done lets verify
-			break;
-		case FLASH_BUSY:
-			if (!flash_wait())
-				///@todo error
-				return false;
-			// job done lets verify
-			break;
-
-		default:
-			///@todo error
+		// write the next word
+		if (!flash_write_word(dst, src))
 			return false;
+		len -= 2;
+		dst++;
+		src++;
 	}
 
-	// verify (now they should be the same)
-	if (*dst != *src)
-		///@todo verify error
-		return false;  // verification error
+	// if we have an odd number of bytes then do the last one
+	if (len == 1)
+	{
+		uint16_t last_word = *src;
+		last_word |= 0xFF00; // little endian (0xFF is erased state)
+		if (!flash_write_word(dst, &last_word))
+			return false;
+	}
 
-	// success
 	return true;
 }
 
@@ -164,25 +197,8 @@ bool nvm_write(void *dst, const void *src, uint32_t len)
 	if (!flash_wait())
 		goto done;
 
-	// write the bytes as 16bit words
-	while (len > 1)
-	{
-		// write the next word
-		if (!flash_write_word(_dst, _src))
-			goto done;
-		len -= 2;
-		_dst++;
-		_src++;
-	}
-
-	// if we have an odd number of bytes then do the last one
-	if (len == 1)
-	{
-		uint16_t last_word = *_src;
-		last_word |= 0xFF00; // little endian (0xFF is erased state)
-		if (!flash_write_word(_dst, &last_word))
-			goto done;
-	}
+	if (!flash_write(_dst, _src, len))
+		goto done;
 
 	// job done !
 	r = true;
@@ -10,6 +10,8 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_PPM
+
 #include <stm32f4xx_conf.h>
 #include <math.h>
 #include "hal.h"
@@ -57,6 +59,7 @@ void ppm_set_phs(ppm_channel_t *ppm, float phs)
 {
 	struct tmr_t *tmr = ppm->tmr;
 	uint32_t ccr;
+	sys_lock_t lock;
 
 	// turn phs into a ccr value
 	if (phs < 0.5)
@@ -80,7 +83,7 @@ void ppm_set_phs(ppm_channel_t *ppm, float phs)
 	{
 		// else we are running so update the CCR from phs asap (this will take
 		// effect after the next timer update event
-		sys_enter_critical_section();
+		lock = sys_lock(SYS_LOCK_KERNEL);
 		switch (ppm->ch)
 		{
 			case TIM_Channel_1:
@@ -100,7 +103,7 @@ void ppm_set_phs(ppm_channel_t *ppm, float phs)
 				TIM_OC4PolarityConfig(tmr->tim, ppm->oc_cfg.TIM_OCPolarity);
 				break;
 		}
-		sys_leave_critical_section();
+		sys_unlock(lock);
 	}
 }
 
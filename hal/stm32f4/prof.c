@@ -0,0 +1,197 @@
+/**
+ * @file prof.c
+ *
+ * @brief implements the pc sampling profiler of the hal
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#define SYS_LOCK_MODULE SYS_LOCK_PROF
+
+#include "hal.h"
+
+// how far up the stack to look for the exception frame (see prof_frame)
+#define PROF_SCAN_WORDS (64)
+
+/* the sample isr fills one block while the other is waiting to be sent (or is
+ * being sent), it is the only writer of the blocks and the counts, the drain
+ * only clears full once a block has been sent */
+static struct
+{
+	struct prof_block_t block[2];
+	volatile uint8_t full[2];		// block is waiting to be sent
+	uint8_t fill;					// block the samples go in
+	uint8_t sending;
+	tmr_t *tmr;
+	uart_t *uart;
+	struct prof_stats_t stats;
+} prof;
+
+
+/* find the exception frame of the interrupted code. The first function in the
+ * isr that calls another pushes lr, which holds the EXC_RETURN value on entry,
+ * and the frame the cpu stacked is just above it (or on the process stack if
+ * EXC_RETURN says so). The stacked xpsr must have the thumb bit set, which
+ * rules out a local that happens to look like an EXC_RETURN */
+static uint32_t *prof_frame(void)
+{
+	uint32_t *sp = (uint32_t *)__get_MSP();
+	uint32_t *frame;
+	uint32_t k, w;
+
+	for (k = 0; k < PROF_SCAN_WORDS; k++)
+	{
+		w = sp[k];
+		// 0xffffffe1, e9, ed, f1, f9 or fd
+		w ^= 0xffffffe1;
+		if ((w & ~0x1c) || (w & 0xc) == 0x4)
+			continue;
+		if (w & 0x4)
+			frame = (uint32_t *)__get_PSP();
+		else
+			frame = &sp[k + 1];
+		if (frame[7] & (1 << 24))
+			return frame;
+	}
+	return NULL;
+}
+
+
+static void prof_sample(tmr_t *tmr, void *param)
+{
+	struct prof_block_t *block = &prof.block[prof.fill];
+	struct prof_sample_t *s;
+	uint32_t *frame;
+
+	if (prof.full[prof.fill])
+	{
+		prof.stats.dropped++;
+		return;
+	}
+	frame = prof_frame();
+	if (frame == NULL)
+	{
+		prof.stats.missed++;
+		return;
+	}
+
+	// stacked r0-r3, r12, lr, pc, xpsr
+	s = &block->sample[block->count];
+	s->pc = frame[6];
+	s->lr = frame[5];
+	s->exception = frame[7] & 0x1ff;
+	prof.stats.samples++;
+
+	if (++block->count == PROF_BLOCK_SAMPLES)
+	{
+		block->dropped = prof.stats.dropped;
+		memory_barrier();
+		prof.full[prof.fill] = 1;
+		prof.fill ^= 1;
+	}
+}
+
+
+void prof_init(tmr_t *tmr, uart_t *uart)
+{
+	prof.block[0].magic = PROF_MAGIC;
+	prof.block[1].magic = PROF_MAGIC;
+	prof.tmr = tmr;
+	prof.uart = uart;
+	tmr_set_update_cb(tmr, prof_sample, NULL);
+}
+
+
+void prof_start(float freq)
+{
+	tmr_set_freq(prof.tmr, freq);
+	tmr_start(prof.tmr);
+}
+
+
+void prof_stop(void)
+{
+	struct prof_block_t *block;
+	sys_lock_t lock;
+
+	tmr_stop(prof.tmr);
+
+	// hand over what there is of the block being filled
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	block = &prof.block[prof.fill];
+	if (!prof.full[prof.fill] && block->count)
+	{
+		block->dropped = prof.stats.dropped;
+		prof.full[prof.fill] = 1;
+		prof.fill ^= 1;
+	}
+	sys_unlock(lock);
+}
+
+
+static void prof_sent(uart_t *uart, void *buf, uint16_t len, void *param)
+{
+	uint32_t b = (uint32_t)(uintptr_t)param;
+
+	// nothing went out (dma refused), keep the block for the next prof_drain
+	// rather than retrying from the completion and recursing
+	if (len == 0)
+	{
+		prof.stats.failed++;
+		prof.sending = 0;
+		return;
+	}
+
+	prof.block[b].count = 0;
+	prof.stats.sent += len;
+	memory_barrier();
+	prof.full[b] = 0;
+	prof.sending = 0;
+
+	// keep sending while there is more
+	prof_drain();
+}
+
+
+void prof_drain(void)
+{
+	uint32_t b;
+	sys_lock_t lock;
+
+	if (prof.uart == NULL)
+		return;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	if (prof.sending)
+		goto done;
+
+	// if both are full the one being filled is the older (the isr moved on to it)
+	b = prof.full[prof.fill] ? prof.fill : prof.fill ^ 1;
+	if (!prof.full[b])
+		goto done;
+
+	// only send the samples there are (prof_stop can hand over a part block)
+	prof.sending = 1;
+	if (uart_write(prof.uart, &prof.block[b], sizeof(struct prof_block_t) - (PROF_BLOCK_SAMPLES - prof.block[b].count) * sizeof(struct prof_sample_t), prof_sent, (void *)(uintptr_t)b) != 0)
+	{
+		// uart busy with another writer, prof_sent will never come so try again on the next drain
+		prof.sending = 0;
+		prof.stats.failed++;
+	}
+
+done:
+	sys_unlock(lock);
+}
+
+
+void prof_get_stats(struct prof_stats_t *stats)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	*stats = prof.stats;
+	sys_unlock(lock);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file prof.h
+ *
+ * @brief statistical pc sampling profiler of the hal
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note a timer update interrupt samples the pc and lr the interrupted code
+ * had (and the exception number it was running, 0 for thread mode) into
+ * blocks, prof_drain sends the full blocks out of a uart with dma, ie run it
+ * from a background task
+ *
+ *	prof_init(&prof_tmr, &uart_dev);
+ *	sched_add_periodic(10, 0, SCHED_PRIORITIES - 1, prof_drain, 0);
+ *	prof_start(997);
+ *
+ * and scripts/prof_fold.py symbolises the samples against the elf and writes
+ * folded stacks (isr or thread;caller;function count) for flamegraph.pl or
+ * speedscope. The timer isr is masked by sys_lock like every driver isr (see
+ * sys_isr_priority), so a sample that falls while the kernel lock is held is
+ * taken just after the unlock. Pick a rate that doesn't beat with anything
+ * periodic (a prime number of Hz)
+ *
+ */
+
+#ifndef __PROF__
+#define __PROF__
+
+/**
+ * samples per block, a block is sent as soon as it is full
+ */
+#ifndef PROF_BLOCK_SAMPLES
+#define PROF_BLOCK_SAMPLES (64)
+#endif
+
+#define PROF_MAGIC (0x50524631)	// "PRF1"
+
+/**
+ * @brief a sample of the interrupted code
+ */
+struct prof_sample_t
+{
+	uint32_t pc;
+	uint32_t lr;			// only a caller if the function hadn't used lr yet
+	uint32_t exception;		// exception number it was running (0 thread mode)
+};
+
+/**
+ * @brief block of samples as it is sent, dropped is the running count of the
+ * samples lost so far
+ */
+struct prof_block_t
+{
+	uint32_t magic;
+	uint32_t count;
+	uint32_t dropped;
+	struct prof_sample_t sample[PROF_BLOCK_SAMPLES];
+};
+
+/**
+ * @brief profiler stats
+ */
+struct prof_stats_t
+{
+	uint32_t samples;		/**< samples taken */
+	uint32_t dropped;		/**< samples lost as both blocks were waiting to be sent */
+	uint32_t missed;		/**< samples where the interrupted frame wasn't found */
+	uint32_t sent;			/**< bytes sent out of the uart */
+	uint32_t failed;		/**< sends the uart refused or completed with nothing sent */
+};
+
+
+/**
+ * @brief set up the profiler
+ * @param tmr timer to sample from (already initialised, its update callback is taken)
+ * @param uart uart the samples are sent out of (already initialised)
+ */
+void prof_init(tmr_t *tmr, uart_t *uart);
+
+
+/**
+ * @brief start sampling
+ * @param freq sample rate in Hz
+ */
+void prof_start(float freq);
+
+
+/**
+ * @brief stop sampling, the part filled block is sent by the next prof_drain
+ */
+void prof_stop(void);
+
+
+/**
+ * @brief start sending the next full block, does nothing if a send is
+ * already running (call it from a background task, it doesn't block)
+ */
+void prof_drain(void);
+
+
+/**
+ * @brief get the profiler stats
+ * @param stats filled in with a copy of the stats
+ */
+void prof_get_stats(struct prof_stats_t *stats);
+
+#endif
@@ -10,6 +10,8 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_PWM
+
 #include <stm32f4xx_conf.h>
 #include <math.h>
 #include "hal.h"
@@ -63,6 +65,7 @@ void pwm_set_duty(pwm_channel_t *pwm, float duty)
 {
 	struct tmr_t *tmr = pwm->tmr;
 	uint32_t ccr;
+	sys_lock_t lock;
 
 	// calc ccr value from duty (duty is always high time so this is slightly
 	// different for PWM mode 1 & 2)
@@ -91,7 +94,7 @@ void pwm_set_duty(pwm_channel_t *pwm, float duty)
 	{
 		// else we are running so update the CCR from duty asap (this will take
 		// effect after the next timer update event
-		sys_enter_critical_section();
+		lock = sys_lock(SYS_LOCK_KERNEL);
 		switch (pwm->ch)
 		{
 			case TIM_Channel_1:
@@ -107,7 +110,7 @@ void pwm_set_duty(pwm_channel_t *pwm, float duty)
 				TIM_SetCompare4(tmr->tim, ccr);
 				break;
 		}
-		sys_leave_critical_section();
+		sys_unlock(lock);
 	}
 }
 
@@ -126,39 +126,46 @@ void spi_dma_cfg(int dir, SPI_TypeDef *channel, dma_request_t *dma_req, void *bu
 }
 
 
-// dummy irq handler that is overridden if spi slave is included
-weak void spis_irq_handler(int n)
+// dummy irq handler that is overridden if spi slave is included (in ram like
+// the handlers so the call from them doesn't go back to the flash)
+weak ramfunc void spis_irq_handler(int n)
 {
 }
 
 
 // dummy irq handler that is overridden if spi master is included
-weak void spim_irq_handler(int n)
+weak ramfunc void spim_irq_handler(int n)
 {
 }
 
 
 // handle the spi1 isr
-void SPI1_IRQHandler(void)
+ramfunc void SPI1_IRQHandler(void)
 {
+	trace_isr_enter();
 	spis_irq_handler(0);
 	spim_irq_handler(0);
+	trace_isr_exit();
 }
 
 
 // handle the spi1 isr
-void SPI2_IRQHandler(void)
+ramfunc void SPI2_IRQHandler(void)
 {
+	trace_isr_enter();
 	spis_irq_handler(1);
 	spim_irq_handler(1);
+	trace_isr_exit();
 }
 
 
 // handle the spi1 isr
-void SPI3_IRQHandler(void)
+ramfunc void SPI3_IRQHandler(void)
 {
+	trace_isr_enter();
 	spis_irq_handler(2);
 	spim_irq_handler(2);
+	trace_isr_exit();
 }
 
 
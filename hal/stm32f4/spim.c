@@ -10,6 +10,8 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_SPIM
+
 #include <stm32f4xx_conf.h>
 #include "hal.h"
 #include "spi.h"
@@ -22,12 +24,13 @@
 static void set_addr(spim_t *spim, uint16_t addr)
 {
 	gpio_pin_t **nss;
+	sys_lock_t lock;
 
 	// do this addressing as quickly as possible so it looks
 	// continuous (some chips might get accidentally addressed
 	// very quickly like this, but the alternative it to use
 	// ports instead of pins which is less flexible)
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 	for (nss = spim->nss; *nss != NULL; addr >>= 1, nss++)
 	{
 		if (addr & 0x01)
@@ -35,12 +38,12 @@ static void set_addr(spim_t *spim, uint16_t addr)
 		else
 			gpio_set_pin(*nss, 1);
 	}
-	sys_leave_critical_section();
+	sys_unlock(lock);
 }
 
 
 // look up the irq channel for this spi master and save a look up for this object when the isr happens
-static spim_t *spim_irq_list[3] = {NULL,};  ///< just store the spim handle so we can get it in the irq (then hw.c is more free form)
+static spim_t *spim_irq_list[3] at_ccm_bss = {NULL,};  ///< just store the spim handle so we can get it in the irq (then hw.c is more free form)
 static uint8_t spim_irq(spim_t *spim)
 {
 	switch ((uint32_t)spim->channel)
@@ -61,9 +64,11 @@ static uint8_t spim_irq(spim_t *spim)
 }
 
 
-void spim_read_phase(spim_t *spim)
+// the phases run from ram with the irq handler (see spi.c) and go to the
+// registers rather than the st library
+ramfunc void spim_read_phase(spim_t *spim)
 {
-	uint8_t b = SPI_ReceiveData(spim->channel);
+	uint8_t b = spim->channel->DR;
 
 	// put the new byte into the read buffer
 	if (spim->read_count < spim->len)
@@ -75,7 +80,7 @@ void spim_read_phase(spim_t *spim)
 }
 
 
-bool spim_write_phase(spim_t *spim)
+ramfunc bool spim_write_phase(spim_t *spim)
 {
 	uint8_t b;
 
@@ -85,7 +90,7 @@ bool spim_write_phase(spim_t *spim)
 			b = 0x00;	// if null buffer transmit a dummy byte so the reads still occur
 		else
 			b = spim->write_buf[spim->write_count];
-		SPI_SendData(spim->channel, b);
+		spim->channel->DR = b;
 		spim->write_count++;
 		return true;
 	}
@@ -105,7 +110,7 @@ void spim_clear_io(spim_t *spim)
 }
 
 
-void spim_irq_handler(int n)
+ramfunc void spim_irq_handler(int n)
 {
 	spim_t *spim = spim_irq_list[n];
 
@@ -116,11 +121,11 @@ void spim_irq_handler(int n)
 	//@todo check for errors (what errors can the master have really ?)
 	
 	// read phase (read the Rx register)
-	if (SPI_I2S_GetITStatus(spim->channel, SPI_I2S_IT_RXNE) == SET)
+	if ((spim->channel->CR2 & SPI_CR2_RXNEIE) && (spim->channel->SR & SPI_SR_RXNE))
 		spim_read_phase(spim);
 	
 	// write phase (reload the Tx register if it is empty and the isr is enabled)
-	if (SPI_I2S_GetITStatus(spim->channel, SPI_I2S_IT_TXE) == SET)
+	if ((spim->channel->CR2 & SPI_CR2_TXEIE) && (spim->channel->SR & SPI_SR_TXE))
 		spim_write_phase(spim);
 
 	// handle completion callback
@@ -136,6 +141,7 @@ void spim_irq_handler(int n)
 		SPI_I2S_ITConfig(spim->channel, SPI_I2S_IT_RXNE, DISABLE);
 		SPI_I2S_ITConfig(spim->channel, SPI_I2S_IT_TXE, DISABLE);
 		spim_clear_io(spim);
+		trace(TRACE_SPIM_DONE, trace_obj(spim));
 		if (complete != NULL)
 			complete(spim, spim->addr, read_buf, write_buf, len, param);
 	}
@@ -155,6 +161,7 @@ void spim_rx_dma_complete(dma_request_t *req, void *param)
 	SPI_I2S_ITConfig(spim->channel, SPI_I2S_IT_RXNE, DISABLE);
 	SPI_I2S_ITConfig(spim->channel, SPI_I2S_IT_TXE, DISABLE);
 	spim_clear_io(spim);
+	trace(TRACE_SPIM_DONE, trace_obj(spim));
 	if (complete != NULL)
 		complete(spim, spim->addr, read_buf, write_buf, len, spim_xfer_param);
 }
@@ -178,6 +185,7 @@ void spim_xfer(spim_t *spim, spim_xfer_opts *opts, uint16_t addr, void *read_buf
 {
 	float fclk = spi_get_clk_speed(spim->channel);
 	int k;
+	sys_lock_t lock;
 
 	// update speed from opts if needed (do this outside critical section)
 	if (opts->speed)
@@ -193,7 +201,7 @@ success:
 		opts->speed = 0; // done, we don't need to wast time calculating this again
 	}
 
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	if (spim->read_buf != NULL || spim->read_count != 0 ||
 		spim->write_buf != NULL || spim->write_count != 0)
@@ -209,6 +217,7 @@ success:
 	spim->len = len;
 	spim->xfer_complete = complete;
 	spim->xfer_complete_param = param;
+	trace(TRACE_SPIM_XFER, trace_obj(spim));
 
 	// flush the buffers so the xfer begins a new
 	spi_flush_rx_fifo(spim->channel);
@@ -225,7 +234,8 @@ success:
 		spim->rx_dma_req.complete_param = spim;
 		spim->rx_dma_req.dma = spim->rx_dma;
 		spi_dma_cfg(SPI_DMA_DIR_RX, spim->channel, &spim->rx_dma_req, spim->read_buf, spim->len);
-		dma_request(&spim->rx_dma_req);
+		if (dma_request(&spim->rx_dma_req) != 0)
+			goto dma_failed;
 		SPI_I2S_DMACmd(spim->channel, SPI_I2S_DMAReq_Rx, ENABLE);
 	}
 	
@@ -247,11 +257,26 @@ success:
 		spim->tx_dma_req.dma = spim->tx_dma;
 		spi_dma_cfg(SPI_DMA_DIR_TX, spim->channel, &spim->tx_dma_req, spim->write_buf, spim->len);
 		SPI_I2S_DMACmd(spim->channel, SPI_I2S_DMAReq_Tx, ENABLE);
-		dma_request(&spim->tx_dma_req);
+		if (dma_request(&spim->tx_dma_req) != 0)
+			goto dma_failed;
 	}
 
 done:
-	sys_leave_critical_section();
+	sys_unlock(lock);
+	return;
+
+dma_failed:
+	// the dma can't reach a buffer (ie it is in the ccm), undo the xfer and complete with nothing transferred
+	SPI_I2S_DMACmd(spim->channel, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+	dma_cancel(spim->rx_dma);
+	SPI_Cmd(spim->channel, DISABLE);
+	set_addr(spim, spim->idle_address);
+	SPI_I2S_ITConfig(spim->channel, SPI_I2S_IT_RXNE, DISABLE);
+	spim_clear_io(spim);
+	sys_unlock(lock);
+	trace(TRACE_SPIM_DONE, trace_obj(spim));
+	if (complete != NULL)
+		complete(spim, addr, read_buf, write_buf, 0, param);
 }
 
 
@@ -272,7 +297,7 @@ void spim_init(spim_t *spim)
 	// setup the spim isr
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	nvic_init.NVIC_IRQChannel = spim_irq(spim);
-	nvic_init.NVIC_IRQChannelPreemptionPriority = spim->preemption_priority;
+	nvic_init.NVIC_IRQChannelPreemptionPriority = sys_isr_priority(spim->preemption_priority);
 	nvic_init.NVIC_IRQChannelSubPriority = 0;
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&nvic_init);
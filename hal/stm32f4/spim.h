@@ -55,6 +55,9 @@ typedef void (*spim_xfer_complete)(spim_t *spim, uint16_t addr, void *read_buf,
  * @param len write & read this many byte to/from the read/write buf's
  * @param complete call this when len bytes are transfered
  * @param param complete parameter
+ * @note with dma (and len > 1) the buffers can't be in the ccm (the dma has no path to it),
+ * that includes the main stack so don't pass local buffers, complete is called straight
+ * away with len 0
  */
 void spim_xfer(spim_t *spim, spim_xfer_opts *opts, uint16_t addr, void *read_buf, void *write_buf, int len, spim_xfer_complete complete, void *param);
 
@@ -10,6 +10,8 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_SPIS
+
 #include <stm32f4xx_conf.h>
 #include "hal.h"
 #include "spi.h"
@@ -67,7 +69,7 @@ void spis_flush_write(spis_t *spis)
 
 
 // look up the irq channel for this spi slave and save a look up for this object when the isr happens
-static spis_t *spis_irq_list[3] = {NULL,};  ///< just store the spis handle so we can get it in the irq (then hw.c is more free form)
+static spis_t *spis_irq_list[3] at_ccm_bss = {NULL,};  ///< just store the spis handle so we can get it in the irq (then hw.c is more free form)
 static uint8_t spis_irq(spis_t *spis)
 {
 	switch ((uint32_t)spis->channel)
@@ -149,7 +151,7 @@ void spis_init(spis_t *spis)
 	// setup the spis isr
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	nvic_init.NVIC_IRQChannel = spis_irq(spis);
-	nvic_init.NVIC_IRQChannelPreemptionPriority = spis->preemption_priority;
+	nvic_init.NVIC_IRQChannelPreemptionPriority = sys_isr_priority(spis->preemption_priority);
 	nvic_init.NVIC_IRQChannelSubPriority = 0;
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&nvic_init);
@@ -167,10 +169,11 @@ void spis_init(spis_t *spis)
 
 
 // read the bytes from the rx buf move the buffers on and possibly call the completion event
-static spis_read_complete spis_read_phase(spis_t *spis, void **buf, uint16_t *len, void **param)
+// (the phases run from ram with the irq handler, see spi.c, so they go to the registers)
+static ramfunc spis_read_complete spis_read_phase(spis_t *spis, void **buf, uint16_t *len, void **param)
 {
 	// pull the next byte out of the fifo
-	uint8_t b = SPI_ReceiveData(spis->channel);
+	uint8_t b = spis->channel->DR;
 
 	// put the new byte into the read buffer (always inc read_count incase we are doing a 
 	// dummy read, ie read_buf == NULL but we want the cb to run)
@@ -194,7 +197,7 @@ static spis_read_complete spis_read_phase(spis_t *spis, void **buf, uint16_t *le
 }
 
 // write the bytes to the tx buf move the buffers on and possibly call the completion event
-static spis_write_complete spis_write_phase(spis_t *spis, void **buf, uint16_t *len, void **param)
+static ramfunc spis_write_complete spis_write_phase(spis_t *spis, void **buf, uint16_t *len, void **param)
 {
 	uint8_t b = 0xaa; // send this dummy byte if we have nothing else available
 
@@ -204,7 +207,7 @@ static spis_write_complete spis_write_phase(spis_t *spis, void **buf, uint16_t *
 		b = spis->write_buf[spis->write_count];
 	spis->write_count++;
 
-	SPI_SendData(spis->channel, b);
+	spis->channel->DR = b;
 
 	if (spis->write_count == spis->write_buf_len && spis->write_buf_len > 0)
 	{
@@ -220,7 +223,7 @@ static spis_write_complete spis_write_phase(spis_t *spis, void **buf, uint16_t *
 }
 
 
-void spis_irq_handler(int n)
+ramfunc void spis_irq_handler(int n)
 {
 	spis_read_complete read_cb = NULL;
 	spis_write_complete write_cb = NULL;
@@ -252,17 +255,17 @@ void spis_irq_handler(int n)
 		// valid byte out really)
 		while (SPI_I2S_GetITStatus(spis->channel, SPI_I2S_IT_OVR) == SET)
 		{
-			SPI_ReceiveData(spis->channel);
+			(void)spis->channel->DR;
 			SPI_I2S_GetFlagStatus(spis->channel, SPI_I2S_FLAG_OVR);
 		}
 	}
 
 	// read phase (read the Rx register)
-	if (SPI_I2S_GetITStatus(spis->channel, SPI_I2S_IT_RXNE) == SET)
+	if ((spis->channel->CR2 & SPI_CR2_RXNEIE) && (spis->channel->SR & SPI_SR_RXNE))
 		read_cb = spis_read_phase(spis, &read_cb_buf, &read_cb_len, &read_cb_param);
 
 	// write phase (reload the Tx register if it is empty and the isr is enabled)
-	if (SPI_I2S_GetITStatus(spis->channel, SPI_I2S_IT_TXE) == SET)
+	if ((spis->channel->CR2 & SPI_CR2_TXEIE) && (spis->channel->SR & SPI_SR_TXE))
 		write_cb = spis_write_phase(spis, &write_cb_buf, &write_cb_len, &write_cb_param);
 
 	// run deferred completion events, defer these so that we read new data out
@@ -319,12 +322,13 @@ void spis_read(spis_t *spis, void *buf, uint16_t len, spis_read_complete cb, voi
 	void *read_cb_buf;
 	uint16_t read_cb_len;
 	void *read_cb_param;
+	sys_lock_t lock;
 
 	///@todo more sanity checks
 	if (len < 1)
 		///@todo invalid input parameters
 		goto error;
-	sys_enter_critical_section();   // lock while changing things so an isr does not find a half setup read
+	lock = sys_lock(SYS_LOCK_KERNEL);   // lock while changing things so an isr does not find a half setup read
 	if (spis->read_buf != NULL || spis->read_count != 0)
 		///@todo read in progress already
 		goto error;
@@ -354,11 +358,20 @@ void spis_read(spis_t *spis, void *buf, uint16_t len, spis_read_complete cb, voi
 		spis->rx_dma_req.dma = spis->rx_dma;
 		spi_dma_cfg(SPI_DMA_DIR_RX, spis->channel, &spis->rx_dma_req, spis->read_buf, spis->read_buf_len);
 		SPI_I2S_DMACmd(spis->channel, SPI_I2S_DMAReq_Rx, ENABLE);
-		dma_request(&spis->rx_dma_req);
+		if (dma_request(&spis->rx_dma_req) != 0)
+		{
+			// the dma can't reach buf (ie it is in the ccm), complete with nothing read
+			SPI_I2S_DMACmd(spis->channel, SPI_I2S_DMAReq_Rx, DISABLE);
+			spis_clear_read(spis);
+			sys_unlock(lock);
+			if (cb != NULL)
+				cb(spis, buf, 0, param);
+			return;
+		}
 	}
 
 error:
-	sys_leave_critical_section();
+	sys_unlock(lock);
 	return;
 }
 
@@ -369,13 +382,14 @@ void spis_write(spis_t *spis, void *buf, uint16_t len, spis_write_complete cb, v
 	void *write_cb_buf;
 	uint16_t write_cb_len;
 	void *write_cb_param;
+	sys_lock_t lock;
 
 	///@todo more sanity checks
 	if (len < 1)
 		///@todo invalid input parameters
 		return;
 
-	sys_enter_critical_section();   // lock while changing things so an isr does not find a half setup read
+	lock = sys_lock(SYS_LOCK_KERNEL);   // lock while changing things so an isr does not find a half setup read
 
 	if (spis->write_buf != NULL || spis->write_count != 0)
 		///@todo write in progress already
@@ -410,10 +424,19 @@ void spis_write(spis_t *spis, void *buf, uint16_t len, spis_write_complete cb, v
 		spis->tx_dma_req.dma = spis->tx_dma;
 		spi_dma_cfg(SPI_DMA_DIR_TX, spis->channel, &spis->tx_dma_req, spis->write_buf, spis->write_buf_len);
 		SPI_I2S_DMACmd(spis->channel, SPI_I2S_DMAReq_Tx, ENABLE);
-		dma_request(&spis->tx_dma_req);
+		if (dma_request(&spis->tx_dma_req) != 0)
+		{
+			// the dma can't reach buf (ie it is in the ccm), complete with nothing written
+			SPI_I2S_DMACmd(spis->channel, SPI_I2S_DMAReq_Tx, DISABLE);
+			spis_clear_write(spis, true);
+			sys_unlock(lock);
+			if (cb != NULL)
+				cb(spis, buf, 0, param);
+			return;
+		}
 	}
 done:
-	sys_leave_critical_section();
+	sys_unlock(lock);
 	return;
 }
 
@@ -97,6 +97,8 @@ typedef void (*spis_read_complete)(spis_t *spis, void *buf, uint16_t len, void *
  * @param len number of bytes to read before cb is called
  * @param cb completion callback, this is called when number of bytes is finished reading or the transaction ends (nss goes hi)
  * @param param parameter passed to the completion callback
+ * @note with an rx dma (and len > 4) buf can't be in the ccm or on the main stack (see
+ * spim_xfer), cb is called straight away with len 0
  */
 void spis_read(spis_t *spis, void *buf, uint16_t len, spis_read_complete cb, void *param);
 
@@ -125,6 +127,8 @@ typedef void (*spis_write_complete)(spis_t *spis, void *buf, uint16_t len, void
  * @param len number of bytes in the buffer (if spis transaction continues return empty bits)
  * @param cb completion callback, this is called when number of bytes is sent or the transaction ends (nss goes hi)
  * @param param parameter passed to the completion callback
+ * @note with a tx dma (and len > 3) buf can't be in the ccm or on the main stack (see
+ * spim_xfer), cb is called straight away with len 0
  */
 void spis_write(spis_t *spis, void *buf, uint16_t len, spis_write_complete cb, void *param);
 
@@ -10,10 +10,23 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_SYS
+
+#include <string.h>
 #include <stm32f4xx_conf.h>
 #include "hal.h"
 
 
+/* the 64bit time is the ms count plus the cycle count at the start of that ms.
+ * The tick isr writes a new copy to the other slot and then moves time_seq on,
+ * so a reader (at any isr priority) uses the copy time_seq points to and only
+ * has to read again if a new copy was written while it was reading */
+struct sys_time_t
+{
+	uint64_t ms;
+	uint32_t cycles;
+};
+
 /* internal structure used to store system states etc so they are all in
  * one easy place to find. */
 struct SYS_T
@@ -21,8 +34,16 @@ struct SYS_T
 	volatile uint32_t ticks;
 	volatile int32_t critical_section_count;
 	enum SYS_ERR error;
+	struct sys_idle_stats_t idle;
+	struct sys_time_t time[2];
+	volatile uint32_t time_seq;
+#if SYS_LOCK_STATS
+	uint32_t lock_start;
+	uint8_t lock_module;
+	struct sys_lock_stats_t lock_stats;
+#endif
 };
-static struct SYS_T sys = {0,};
+static struct SYS_T sys at_ccm_bss = {0,};
 
 
 // setup all the system clocks
@@ -91,7 +112,9 @@ static void sys_clk_init(void)
 // init system interrupts
 static void sys_interrupt_init(void)
 {
-	///@todo stub for now (we should at least call NVIC_PriorityGroupConfig() here
+	// all 4 priority bits are preemption priority, sys_lock masks by preemption
+	// priority so with fewer bits its ceilings would cover more than asked for
+	NVIC_PriorityGroupConfig(NVIC_PriorityGroup_4);
 }
 
 
@@ -102,13 +125,6 @@ static void sys_temp_init(void)
 }
 
 
-// init a log via uart or trace
-static void sys_log_init(void)
-{
-	///@todo uart log
-}
-
-
 // disable all interrupts and inc the counter so this can be re-entrant
 void sys_enter_critical_section(void)
 {
@@ -142,6 +158,68 @@ void sys_leave_critical_section(void)
 }
 
 
+// raise basepri to the ceiling, basepri_max only ever raises the mask so a
+// nested lock with a lower ceiling doesn't unmask anything
+sys_lock_t sys_lock_module(uint8_t ceiling, uint8_t module)
+{
+	sys_lock_t prev = __get_BASEPRI();
+
+	if (ceiling == 0)
+		ceiling = 1;
+	__set_BASEPRI_MAX(ceiling << (8 - __NVIC_PRIO_BITS));
+
+#if SYS_LOCK_STATS
+	// only the outermost lock is timed (an isr above the ceiling that locks
+	// while we hold a lock sees a non zero prev so it doesn't restart the timing)
+	if (prev == 0)
+	{
+		sys.lock_start = sys_cycle_stamp();
+		sys.lock_module = module;
+	}
+#endif
+	return prev;
+}
+
+
+void sys_unlock(sys_lock_t lock)
+{
+#if SYS_LOCK_STATS
+	if (lock == 0)
+	{
+		uint32_t cycles = sys_cycle_stamp() - sys.lock_start;
+
+		sys.lock_stats.locks[sys.lock_module]++;
+		if (cycles > sys.lock_stats.cycles_max[sys.lock_module])
+			sys.lock_stats.cycles_max[sys.lock_module] = cycles;
+	}
+#endif
+	__set_BASEPRI(lock);
+}
+
+
+void sys_get_lock_stats(struct sys_lock_stats_t *stats)
+{
+#if SYS_LOCK_STATS
+	// isrs above the ceiling can time their own locks so mask everything to copy
+	sys_enter_critical_section();
+	*stats = sys.lock_stats;
+	sys_leave_critical_section();
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+
+void sys_clear_lock_stats(void)
+{
+#if SYS_LOCK_STATS
+	sys_enter_critical_section();
+	memset(&sys.lock_stats, 0, sizeof(sys.lock_stats));
+	sys_leave_critical_section();
+#endif
+}
+
+
 // get the system clock speed in Hz
 uint32_t sys_clk_freq(void)
 {
@@ -149,9 +227,64 @@ uint32_t sys_clk_freq(void)
 }
 
 
+// start the DWT cycle counter
+static void sys_cycles_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+uint32_t sys_get_cycles(void)
+{
+	return DWT->CYCCNT;
+}
+
+
+// move the time on by ms, the new ms started at cycle count start (call from the
+// tick isr or with interrupts masked, there is only ever one writer)
+static void sys_time_update(uint32_t ms, uint32_t start)
+{
+	uint32_t seq = sys.time_seq;
+	struct sys_time_t *t = &sys.time[(seq + 1) & 1];
+
+	t->ms = sys.time[seq & 1].ms + ms;
+	t->cycles = start;
+	__DMB();
+	sys.time_seq = seq + 1;
+}
+
+
+uint64_t sys_time_us64(void)
+{
+	uint32_t seq, cycles;
+	uint64_t ms;
+
+	// the cycles since the start of the ms are counted even if the tick isr is
+	// held off, so a late tick doesn't make the time go backwards
+	do
+	{
+		seq = sys.time_seq;
+		// sys.time isn't volatile, the barriers keep its reads between the
+		// reads of time_seq (the other side of the one in sys_time_update)
+		__DMB();
+		ms = sys.time[seq & 1].ms;
+		cycles = DWT->CYCCNT - sys.time[seq & 1].cycles;
+		__DMB();
+	} while (seq != sys.time_seq);
+
+	return ms * 1000 + cycles / (SYS_CLK / 1000000);
+}
+
+
 // setup the tick handler interrupt rate
 static void sys_tick_init()
 {
+	sys.time[0].ms = 0;
+	sys.time[0].cycles = DWT->CYCCNT;
+	sys.time_seq = 0;
+
 	if (SysTick_Config(SYS_CLK / 1000) != 0)
 	{}
 
@@ -159,23 +292,135 @@ static void sys_tick_init()
 }
 
 
+// does nothing unless overridden (ie by the scheduler's threads)
+weak void sys_tick_hook(void)
+{
+}
+
+
 // sys tick ISR (overrides weak functions from st libs)
 void SysTick_Handler(void)
 {
+	trace_isr_enter();
 	sys.ticks++;
+	// the ms started when systick wrapped, LOAD - VAL cycles ago
+	sys_time_update(1, DWT->CYCCNT - (SysTick->LOAD - SysTick->VAL));
+	sys_tick_hook();
+	trace_isr_exit();
 }
 
 
-// get the current system time with ms resolution, use a shadow to protect against interrupts
-uint32_t sys_get_tick(void)
+// systick is stretched to the deadline for tickless idle, it is a 24 bit
+// counter so this is the longest single sleep
+#define SYS_CLK_PER_TICK (SYS_CLK / 1000)
+#define SYS_IDLE_MAX_TICKS (SysTick_LOAD_RELOAD_Msk / SYS_CLK_PER_TICK)
+
+// restart systick so the next tick interrupt is in cycles and then every 1ms
+static void sys_tick_restart(uint32_t cycles)
+{
+	SysTick->LOAD = cycles - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	SysTick->LOAD = SYS_CLK_PER_TICK - 1; // used from the next reload
+}
+
+
+// sleep until tick, the tick interrupt is held off until the deadline and the
+// ticks that went by while asleep are added on wake
+uint32_t sys_idle_until(uint32_t tick)
 {
-	uint32_t tick_shadow;
+	uint32_t remaining, load, ctrl, cycles, now, slept = 0;
+	int32_t ticks;
 
+	// interrupts are masked so they do not run until the tick count is fixed up
+	// but a pending interrupt still wakes the wfi
 	sys_enter_critical_section();
-	tick_shadow = sys.ticks;
+
+	ticks = sys_tick_diff(sys.ticks, tick);
+	if (ticks <= 0)
+		goto done;
+	if (ticks == 1)
+	{
+		// the normal tick will wake us
+		__DSB();
+		__WFI();
+		goto done;
+	}
+	if (ticks > SYS_IDLE_MAX_TICKS)
+		ticks = SYS_IDLE_MAX_TICKS;
+
+	// stop the tick and load it with the cycles left in this tick plus the
+	// whole ticks to the deadline (unless a tick is already due)
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+	{
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+		goto done;
+	}
+	remaining = SysTick->VAL;
+	load = remaining + (ticks - 1) * SYS_CLK_PER_TICK;
+	SysTick->LOAD = load;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+	__DSB();
+	__WFI();
+	__ISB();
+
+	// stop the tick again and work out how long we were asleep (reading ctrl
+	// clears the count flag so it is only read once)
+	ctrl = SysTick->CTRL;
+	SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+	cycles = load - SysTick->VAL;
+	now = DWT->CYCCNT;
+	sys.idle.sleeps++;
+	if (ctrl & SysTick_CTRL_COUNTFLAG_Msk)
+	{
+		// woke on the deadline, the pending tick interrupt adds the deadline
+		// tick itself and cycles is now how long it took to get running again
+		slept = ticks - 1 + cycles / SYS_CLK_PER_TICK;
+		sys.idle.wake_latency = cycles;
+		if (cycles > sys.idle.wake_latency_max)
+			sys.idle.wake_latency_max = cycles;
+		cycles %= SYS_CLK_PER_TICK;
+		// the time is a tick behind until the pending tick isr runs
+		now -= SYS_CLK_PER_TICK;
+	}
+	else
+	{
+		// woken early by another interrupt, count the whole ticks since the
+		// last tick and keep the part tick so the tick phase is not lost
+		sys.idle.early_wakes++;
+		cycles += SYS_CLK_PER_TICK - remaining;
+		slept = cycles / SYS_CLK_PER_TICK;
+		cycles %= SYS_CLK_PER_TICK;
+	}
+	sys.ticks += slept;
+	sys.idle.idle_ticks += slept;
+	sys_time_update(slept, now - cycles);
+	sys_tick_restart(SYS_CLK_PER_TICK - cycles);
+
+done:
 	sys_leave_critical_section();
+	return slept;
+}
+
 
-	return(tick_shadow);
+void sys_get_idle_stats(struct sys_idle_stats_t *stats)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	*stats = sys.idle;
+	sys_unlock(lock);
+}
+
+
+// get the current system time with ms resolution, a 32bit read can't be torn so
+// there is no need to mask interrupts
+uint32_t sys_get_tick(void)
+{
+	return sys.ticks;
 }
 
 
@@ -232,7 +477,9 @@ void sys_run(void *func, uint8_t argc, uint32_t argv[])
 	// to be pushed onto the stack which is much harder as the types matter
 	// then)
 	t = (sys_task)func;
+	trace(TRACE_TASK_START, trace_obj(func));
 	t(argv[0], argv[1], argv[2], argv[3]);
+	trace(TRACE_TASK_END, trace_obj(func));
 }
 
 
@@ -243,32 +490,193 @@ void sys_reset(void)
 }
 
 
-///@todo need a prototype for printf
-void sys_log()
+/* the crash dump is in .noinit so it survives the reset (sys_init checks it),
+ * it is only trusted if the magic and the check sum are right */
+struct sys_crash_t sys_crash at_symbol(".noinit");
+static uint8_t sys_crash_valid;
+
+// the fault handlers run on a stack of their own so a stack overflow can still
+// be saved (not static so the handlers can find it, see sys_fault_entry)
+uint64_t sys_fault_stack[32];
+
+// linker symbols (see the .ld files)
+extern uint32_t _sidata, _sdata, _edata, _sbss, _ebss;
+extern uint32_t _siramfunc, _sramfunc, _eramfunc;
+extern uint32_t _siccmdata, _sccmdata, _eccmdata, _sccmbss, _eccmbss;
+extern uint32_t _eram, _estack;
+
+
+// is a run of words in ram or the ccm (so it is safe to read from a fault handler)
+static int sys_in_ram(uint32_t *p, uint32_t words)
+{
+	uint32_t addr = (uint32_t)p;
+	uint32_t end = addr + words * sizeof(uint32_t);
+
+	if (addr & 0x3)
+		return 0;
+	return (addr >= SRAM_BASE && end <= (uint32_t)&_eram) || (addr >= CCMDATARAM_BASE && end <= (uint32_t)&_estack);
+}
+
+
+static uint32_t sys_crash_sum(struct sys_crash_t *crash)
+{
+	uint32_t *p = (uint32_t *)crash;
+	uint32_t sum = 0;
+
+	while (p < &crash->check)
+		sum += *p++;
+	return sum;
+}
+
+
+// the weak default for when the log isn't linked in (see log_copy)
+weak uint32_t log_copy(uint32_t *buf, uint32_t words)
 {
+	return 0;
 }
 
 
-void BusFault_Handler(void)
+/* save what we can about the fault, the copies are all bounded so this only
+ * takes a few us and the watchdog recovery time doesn't change. Not static
+ * as it is called from the handlers */
+void sys_fault(uint32_t *frame, uint32_t exc_return)
 {
-	//if (CoreDebug->DHCSR & 0x01)		//is C_DEBUGEN set, is the debugger connected?
+	struct sys_crash_t *crash = &sys_crash;
+	uint32_t *sp;
+	uint32_t k;
+#if TRACE
+	struct trace_record_t *r;
+	uint32_t head;
+#endif
+
+	crash->magic = 0;
+	crash->exception = __get_IPSR() & 0x1ff;
+	crash->exc_return = exc_return;
+	crash->tick = sys.ticks;
+	crash->cfsr = SCB->CFSR;
+	crash->hfsr = SCB->HFSR;
+	crash->mmfar = SCB->MMFAR;
+	crash->bfar = SCB->BFAR;
+	crash->stack_size = SYS_CRASH_STACK_WORDS;
+	crash->trace_size = SYS_CRASH_TRACE_RECORDS;
+	crash->log_size = SYS_CRASH_LOG_WORDS;
+
+	// the frame might be what faulted (ie a stack overflow) so only read it if it is in ram
+	crash->stack_words = 0;
+	crash->sp = (uint32_t)frame;
+	memset(crash->frame, 0, sizeof(crash->frame));
+	if (sys_in_ram(frame, 8))
+	{
+		for (k = 0; k < 8; k++)
+			crash->frame[k] = frame[k];
+
+		// the faulting code's stack is above the frame (and the fp registers if
+		// they were stacked and the word padding the frame to 8 bytes)
+		sp = frame + ((exc_return & 0x10) ? 8 : 26) + ((frame[7] & (1 << 9)) ? 1 : 0);
+		crash->sp = (uint32_t)sp;
+		for (k = 0; k < SYS_CRASH_STACK_WORDS && sys_in_ram(&sp[k], 1); k++)
+			crash->stack[k] = sp[k];
+		crash->stack_words = k;
+	}
+
+	memset(crash->trace, 0, sizeof(crash->trace));
+#if TRACE
+	trace_ring.on = 0;
+	head = trace_ring.head;
+	for (k = 0; k < SYS_CRASH_TRACE_RECORDS; k++)
 	{
-		//__breakpoint(0);
-		while (1) {};
+		r = &trace_ring.rec[(head - SYS_CRASH_TRACE_RECORDS + k) & (TRACE_RING_SIZE - 1)];
+		crash->trace[k * 2] = r->cycles;
+		crash->trace[k * 2 + 1] = r->what;
 	}
+#endif
+
+	crash->log_words = log_copy(crash->log, SYS_CRASH_LOG_WORDS);
+
+	crash->magic = SYS_CRASH_MAGIC;
+	crash->check = sys_crash_sum(crash);
+	memory_barrier();
+
+	// stop for the debugger if there is one
+	if (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk)
+		__BKPT(0);
 
+#if SYS_FAULT_RESET
+	NVIC_SystemReset();
+#endif
+	while (1) {};
 }
 
+
+/* pass the stacked frame (on the process stack if bit 2 of EXC_RETURN is set)
+ * and EXC_RETURN to sys_fault, on the fault stack */
+#define sys_fault_entry() \
+	__asm volatile ( \
+		"tst lr, #4\n" \
+		"ite eq\n" \
+		"mrseq r0, msp\n" \
+		"mrsne r0, psp\n" \
+		"mov r1, lr\n" \
+		"ldr r2, =sys_fault_stack + 256\n" \
+		"mov sp, r2\n" \
+		"b sys_fault\n" \
+	)
+
+
 /**
- * @brief Hard Fault ISR (a hard fault has occurred, log a message and spin)
+ * @brief Bus Fault ISR (save the crash dump, see sys_get_last_crash)
  */
-void HardFault_Handler(void)
+__attribute__((naked)) void BusFault_Handler(void)
 {
-	//if (CoreDebug->DHCSR & 0x01)		//is C_DEBUGEN set, is the debugger connected?
-	{
-		//__breakpoint(0);
-		while (1) {};
-	}
+	sys_fault_entry();
+}
+
+
+/**
+ * @brief Hard Fault ISR (save the crash dump, see sys_get_last_crash)
+ */
+__attribute__((naked)) void HardFault_Handler(void)
+{
+	sys_fault_entry();
+}
+
+
+int sys_get_last_crash(struct sys_crash_t *crash)
+{
+	if (!sys_crash_valid)
+		return 0;
+	*crash = sys_crash;
+	crash->magic = SYS_CRASH_MAGIC;
+	return 1;
+}
+
+
+extern void SystemInit(void);
+extern int main(void);
+
+/* the startup, this replaces the weak one in the st startup file to set up the
+ * ccm and the ram functions as well as the ram. The main stack is in the ccm,
+ * which is on from reset, so this is plain c, it just can't use any data (or
+ * call a ramfunc) until it is set up */
+void Reset_Handler(void)
+{
+	uint32_t *src, *dst;
+
+	for (src = &_sidata, dst = &_sdata; dst < &_edata;)
+		*dst++ = *src++;
+	for (dst = &_sbss; dst < &_ebss;)
+		*dst++ = 0;
+	for (src = &_siramfunc, dst = &_sramfunc; dst < &_eramfunc;)
+		*dst++ = *src++;
+
+	for (src = &_siccmdata, dst = &_sccmdata; dst < &_eccmdata;)
+		*dst++ = *src++;
+	for (dst = &_sccmbss; dst < &_eccmbss;)
+		*dst++ = 0;
+
+	SystemInit();
+	main();
+	while (1) {};
 }
 
 
@@ -276,10 +684,11 @@ void HardFault_Handler(void)
 enum SYS_ERR sys_get_error(void)
 {
 	enum SYS_ERR sys_error_shadow;
+	sys_lock_t lock;
 
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 	sys_error_shadow = sys.error;
-	sys_leave_critical_section();
+	sys_unlock(lock);
 
 	return sys_error_shadow;
 }
@@ -291,24 +700,28 @@ void sys_nop(void)
 }
 
 
-// spin for time ms
+// spin for time ms (sleeping between ticks rather than polling)
 void sys_spin(uint32_t time)
 {
 	uint32_t end_time = sys_get_tick() + time;
 
 	while (end_time != sys_get_tick())
-	{}
+		__WFI();
 }
 
 
 // setup the basic components of any system
 void sys_init(void)
 {
+	// a crash dump from before the reset is only reported the once
+	sys_crash_valid = sys_crash.magic == SYS_CRASH_MAGIC && sys_crash.check == sys_crash_sum(&sys_crash);
+	sys_crash.magic = 0;
+
 	sys_clk_init();
 	sys_interrupt_init();
+	sys_cycles_init();
 	sys_tick_init();
 	sys_temp_init();
-	sys_log_init();
 }
 
 
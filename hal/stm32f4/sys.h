@@ -41,6 +41,118 @@ void sys_enter_critical_section(void);
 void sys_leave_critical_section(void);
 
 
+/**
+ * ceiling the drivers and the scheduler lock at (see sys_lock). The isrs that
+ * call into mos (driver isrs, sys tick, anything that posts tasks) must have a
+ * preemption priority of SYS_LOCK_KERNEL or lower (numerically greater or
+ * equal), the hal drivers clamp theirs (see sys_isr_priority). Isrs at a
+ * higher priority are never held off by mos, but they must not call it
+ */
+#ifndef SYS_LOCK_KERNEL
+#define SYS_LOCK_KERNEL (1)
+#endif
+
+/**
+ * @brief the preemption priority a driver gives its isr, priorities above
+ * SYS_LOCK_KERNEL (numerically less, ie the default of 0) are clamped to it so
+ * sys_lock always masks the isr
+ */
+#define sys_isr_priority(priority) ((priority) < SYS_LOCK_KERNEL ? SYS_LOCK_KERNEL : (priority))
+
+/**
+ * set to 1 to measure how long each module keeps interrupts masked (see sys_get_lock_stats)
+ */
+#ifndef SYS_LOCK_STATS
+#define SYS_LOCK_STATS (0)
+#endif
+
+/**
+ * @brief modules the masked time is counted against, a source file sets
+ * SYS_LOCK_MODULE before including hal.h to have its locks counted against it
+ * (these only label the stats, they are not ceilings to pass to sys_lock)
+ */
+enum sys_lock_module
+{
+	SYS_LOCK_APP = 0,		/**< anything that doesn't set SYS_LOCK_MODULE */
+	SYS_LOCK_SYS,
+	SYS_LOCK_SCHED,
+	SYS_LOCK_ADC,
+	SYS_LOCK_CRC,
+	SYS_LOCK_HRTIMER,
+	SYS_LOCK_I2C,
+	SYS_LOCK_LOG,
+	SYS_LOCK_PPM,
+	SYS_LOCK_PROF,
+	SYS_LOCK_PWM,
+	SYS_LOCK_SPIM,
+	SYS_LOCK_SPIS,
+	SYS_LOCK_TMR,
+	SYS_LOCK_UART,
+	SYS_LOCK_MODULES
+};
+
+#ifndef SYS_LOCK_MODULE
+#define SYS_LOCK_MODULE SYS_LOCK_APP
+#endif
+
+typedef uint32_t sys_lock_t;
+
+
+/**
+ * the scheduler's task pool and queues are only touched by the cpu so they go
+ * in the ccm (see sched.h)
+ */
+#ifndef SCHED_MEM
+#define SCHED_MEM at_ccm_bss
+#endif
+
+
+/**
+ * @brief mask the interrupts at ceiling and below (ie preemption priority ceiling
+ * to 15) and leave the higher priority interrupts running
+ * @param ceiling highest preemption priority to mask (1 to 15, 0 is taken as 1
+ * as the cpu can't mask priority 0 this way), normally SYS_LOCK_KERNEL
+ * @return the previous mask to pass to sys_unlock
+ * @note locks nest, an inner lock never lowers the mask an outer lock set. Use
+ * sys_enter_critical_section for the few places that need every interrupt off
+ * (ie flash programming, waiting for an interrupt)
+ */
+sys_lock_t sys_lock_module(uint8_t ceiling, uint8_t module);
+#define sys_lock(ceiling) sys_lock_module(ceiling, SYS_LOCK_MODULE)
+
+
+/**
+ * @brief undo a sys_lock
+ * @param lock the value the matching sys_lock returned
+ */
+void sys_unlock(sys_lock_t lock);
+
+
+/**
+ * @brief worst case masked time per module (see SYS_LOCK_STATS), an outermost
+ * lock is counted against the module that took it and includes any locks
+ * nested inside it
+ */
+struct sys_lock_stats_t
+{
+	uint32_t locks[SYS_LOCK_MODULES];		/**< number of outermost locks */
+	uint32_t cycles_max[SYS_LOCK_MODULES];	/**< longest time masked in cpu cycles */
+};
+
+
+/**
+ * @brief get the lock stats (all 0 unless SYS_LOCK_STATS is set)
+ * @param stats filled in with a copy of the stats
+ */
+void sys_get_lock_stats(struct sys_lock_stats_t *stats);
+
+
+/**
+ * @brief clear the lock stats (ie to measure the worst case from a known point)
+ */
+void sys_clear_lock_stats(void);
+
+
 /**
  * @brief return the system clock frequency
  * @return system clock frequency in Hz
@@ -48,14 +160,84 @@ void sys_leave_critical_section(void);
 uint32_t sys_clk_freq(void);
 
 
+/**
+ * @brief called from the sys tick isr after the tick count is incremented
+ * @note this is a weak function that does nothing, define it to run code on
+ * every tick (it runs in the isr so keep it short)
+ */
+void sys_tick_hook(void);
+
+
+/**
+ * @brief get the cpu cycle count (the DWT cycle counter)
+ * @note this wraps every ~25s at 168MHz, take differences of unsigned counts to time
+ * things (see sys_clk_freq to convert to time)
+ * @return the number of cpu cycles since sys_init
+ */
+uint32_t sys_get_cycles(void);
+
+
+/**
+ * @brief get the cpu cycle count inline (the fast path for time stamps, the same count as sys_get_cycles)
+ */
+#if defined(__arm__)
+#define sys_cycle_stamp() (*(volatile uint32_t *)0xe0001004) // DWT->CYCCNT
+#else
+#define sys_cycle_stamp() sys_get_cycles()
+#endif
+
+
+/**
+ * @brief get the time since boot in us as a 64bit count (it never wraps)
+ * @note this doesn't mask interrupts, it is safe from any isr priority and stays
+ * right while the tick isr is held off (for less than a cycle counter wrap)
+ * @return the number of us since sys_init
+ */
+uint64_t sys_time_us64(void);
+
+
 /**
  * @brief get the number of 1ms intervals since boot
- * @note there is not attempt to deal with rollovers in this function
+ * @note there is not attempt to deal with rollovers in this function (see sys_time_us64),
+ * it doesn't mask interrupts
  * @return the number of 1ms ticks that have occurred since boot time
  */
 uint32_t sys_get_tick(void);
 
 
+/**
+ * @brief tickless idle stats (see sys_idle_until)
+ */
+struct sys_idle_stats_t
+{
+	uint32_t sleeps;				/**< number of tickless sleeps */
+	uint32_t early_wakes;			/**< sleeps cut short by an interrupt before the deadline */
+	uint32_t idle_ticks;			/**< total number of ticks spent asleep */
+	uint32_t wake_latency;			/**< cpu cycles from the last deadline until the cpu was running again */
+	uint32_t wake_latency_max;		/**< worst case wake_latency */
+};
+
+
+/**
+ * @brief stop the tick and sleep (wfi) until tick or until an interrupt wakes the cpu
+ * @param tick the time (according to sys_get_tick) to wake up
+ * @return the number of ticks the cpu was asleep
+ * @note the tick count is compensated on wake so sys_get_tick is unaffected. A single
+ * sleep is limited by the 24bit systick (about 99ms), past that the cpu wakes and the
+ * caller can just sleep again. Call this from a critical section after checking there
+ * is nothing to do (ie sched_next_deadline) so an interrupt in between is not missed,
+ * a pending interrupt still wakes the cpu
+ */
+uint32_t sys_idle_until(uint32_t tick);
+
+
+/**
+ * @brief get the tickless idle stats
+ * @param stats filled in with a copy of the stats
+ */
+void sys_get_idle_stats(struct sys_idle_stats_t *stats);
+
+
 /**
  * @brief return the number of ticks between beginning and end and handle wrapping
  * @param beginning lower bound on the time interval
@@ -94,9 +276,65 @@ void sys_reset(void);
 
 
 /**
- * @todo need a prototype for this
+ * set to 1 to reset as soon as a fault has been saved (see sys_get_last_crash),
+ * with 0 the cpu spins until the watchdog resets it as it always has
+ */
+#ifndef SYS_FAULT_RESET
+#define SYS_FAULT_RESET (0)
+#endif
+
+/**
+ * size of the parts of the crash dump, the stack is the words above the
+ * exception frame, the trace the last trace records (with TRACE set) and the
+ * log the last records not yet sent (with the log linked in)
+ */
+#ifndef SYS_CRASH_STACK_WORDS
+#define SYS_CRASH_STACK_WORDS (32)
+#endif
+#ifndef SYS_CRASH_TRACE_RECORDS
+#define SYS_CRASH_TRACE_RECORDS (16)
+#endif
+#ifndef SYS_CRASH_LOG_WORDS
+#define SYS_CRASH_LOG_WORDS (64)
+#endif
+
+#define SYS_CRASH_MAGIC (0x43525348)	// "CRSH"
+
+/**
+ * @brief what the fault handlers save (in .noinit so it survives the reset),
+ * scripts/crash_decode.py decodes a copy of it (ie sent out of a uart or
+ * "dump binary value crash.bin sys_crash" from gdb)
+ */
+struct sys_crash_t
+{
+	uint32_t magic;
+	uint32_t exception;			/**< exception number (3 hard fault, 5 bus fault) */
+	uint32_t exc_return;		/**< lr on entry to the handler */
+	uint32_t tick;				/**< sys_get_tick when it faulted */
+	uint32_t frame[8];			/**< stacked r0-r3, r12, lr, pc, xpsr (0 if the frame wasn't in ram) */
+	uint32_t sp;				/**< sp of the faulting code (above the frame) */
+	uint32_t cfsr;				/**< configurable fault status */
+	uint32_t hfsr;				/**< hard fault status */
+	uint32_t mmfar;				/**< mem manage fault address */
+	uint32_t bfar;				/**< bus fault address */
+	uint16_t stack_size;		/**< SYS_CRASH_STACK_WORDS (so the decoder knows the layout) */
+	uint16_t stack_words;		/**< words of stack saved */
+	uint16_t trace_size;		/**< SYS_CRASH_TRACE_RECORDS */
+	uint16_t log_size;			/**< SYS_CRASH_LOG_WORDS */
+	uint32_t log_words;			/**< words of log saved */
+	uint32_t stack[SYS_CRASH_STACK_WORDS];
+	uint32_t trace[SYS_CRASH_TRACE_RECORDS * 2];	/**< cycles, what pairs oldest first (see struct trace_record_t) */
+	uint32_t log[SYS_CRASH_LOG_WORDS];				/**< log records (see log.h) */
+	uint32_t check;				/**< sum of the words before it */
+};
+
+
+/**
+ * @brief get what was saved by the last fault
+ * @param crash filled in with a copy of the crash dump
+ * @return 1 if the last reset followed a fault (checked by sys_init), 0 otherwise
  */
-void sys_log();
+int sys_get_last_crash(struct sys_crash_t *crash);
 
 
 /**
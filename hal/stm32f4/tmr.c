@@ -14,6 +14,8 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_TMR
+
 #include <stm32f4xx_conf.h>
 #include <math.h>
 #include <float.h>
@@ -26,7 +28,7 @@
 
 
 // look up the irq channel for this tmr
-static tmr_t *tmr_irq_list[14] = {NULL,};  ///< just store the tmr handle so we can get it in the irq (then hw.c is more free form)
+static tmr_t *tmr_irq_list[14] at_ccm_bss = {NULL,};  ///< just store the tmr handle so we can get it in the irq (then hw.c is more free form)
 static uint8_t tmr_irq(tmr_t *tmr)
 {
 	switch ((uint32_t)tmr->tim)
@@ -105,7 +107,7 @@ static void dbg_stop(struct tmr_t *tmr)
 }
 
 
-static uint32_t get_tmr_freq(struct tmr_t *tmr)
+uint32_t tmr_get_clk_freq(struct tmr_t *tmr)
 {
 	uint32_t sys_freq = sys_clk_freq();
 
@@ -235,9 +237,24 @@ void tmr_set_update_cb(tmr_t *tmr, tmr_update_cb_t cb, void *param)
 }
 
 
+void tmr_set_compare_cb(tmr_t *tmr, tmr_compare_cb_t cb, int channel, void *param)
+{
+	uint16_t it = TIM_IT_CC1 << tmr_ch2n(channel);
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	tmr->compare_cb_param[tmr_ch2n(channel)] = param;
+	tmr->compare_cb[tmr_ch2n(channel)] = cb;
+	TIM_ClearITPendingBit(tmr->tim, it);
+	TIM_ITConfig(tmr->tim, it, cb ? ENABLE : DISABLE);
+	sys_unlock(lock);
+}
+
+
 void tmr_set_timebase(tmr_t *tmr, uint32_t arr, uint16_t prescaler)
 {
 	uint8_t k;
+	sys_lock_t lock;
 	arr = CLIP(arr, 0, UINT16_MAX); ///@todo if this is a 32bit timer we can go higher
 
 	// reconfigure the timer to set the desired period
@@ -245,12 +262,12 @@ void tmr_set_timebase(tmr_t *tmr, uint32_t arr, uint16_t prescaler)
 	{
 		// if the timer is already running we will switch to the new period
 		// at the next update event to avoid glitching
-		sys_enter_critical_section();
+		lock = sys_lock(SYS_LOCK_KERNEL);
 		TIM_SetAutoreload(tmr->tim, arr);
 		TIM_PrescalerConfig(tmr->tim, prescaler, TIM_PSCReloadMode_Update);
 		tmr->arr = arr;
 		tmr->prescaler = prescaler;
-		sys_leave_critical_section();
+		sys_unlock(lock);
 	}
 	else
 	{
@@ -278,7 +295,7 @@ void tmr_set_timebase(tmr_t *tmr, uint32_t arr, uint16_t prescaler)
 
 float tmr_set_period(tmr_t *tmr, float period)
 {
-	uint32_t tmr_freq = get_tmr_freq(tmr);
+	uint32_t tmr_freq = tmr_get_clk_freq(tmr);
 	uint32_t arr;
 	uint32_t prescaler; ///@todo if this is a 32bit timer we can go higher
 	uint32_t scale = lroundf((float)tmr_freq * period);
@@ -334,7 +351,7 @@ void tmr_init(tmr_t *tmr)
 	// setup the tmr isr
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	nvic_init.NVIC_IRQChannel = tmr_irq(tmr);
-	nvic_init.NVIC_IRQChannelPreemptionPriority = tmr->preemption_priority;
+	nvic_init.NVIC_IRQChannelPreemptionPriority = sys_isr_priority(tmr->preemption_priority);
 	nvic_init.NVIC_IRQChannelSubPriority = 0;
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&nvic_init);
@@ -378,11 +395,22 @@ static void tmr_irq_handler(int n)
 	tmr_t *tmr = tmr_irq_list[n];
 	tmr_update_cb_t update_cb = NULL;
 	void *update_cb_param = NULL;
+	uint8_t k;
 
 
 	if (tmr == NULL)
 		return;
 
+	// compare channels run their callbacks straight away as they are time critical
+	for (k = 0; k < 4; k++)
+	{
+		if (tmr->compare_cb[k] && TIM_GetITStatus(tmr->tim, TIM_IT_CC1 << k))
+		{
+			TIM_ClearITPendingBit(tmr->tim, TIM_IT_CC1 << k);
+			tmr->compare_cb[k](tmr, tmr_n2ch(k), tmr->compare_cb_param[k]);
+		}
+	}
+
 	if (TIM_GetITStatus(tmr->tim, TIM_IT_Update))
 	{
 		TIM_ClearITPendingBit(tmr->tim, TIM_IT_Update);
@@ -401,30 +429,40 @@ static void tmr_irq_handler(int n)
 
 void TIM2_IRQHandler(void)
 {
+	trace_isr_enter();
 	tmr_irq_handler(2);
+	trace_isr_exit();
 }
 
 
 void TIM3_IRQHandler(void)
 {
+	trace_isr_enter();
 	tmr_irq_handler(3);
+	trace_isr_exit();
 }
 
 
 void TIM4_IRQHandler(void)
 {
+	trace_isr_enter();
 	tmr_irq_handler(4);
+	trace_isr_exit();
 }
 
 
 void TIM5_IRQHandler(void)
 {
+	trace_isr_enter();
 	tmr_irq_handler(5);
+	trace_isr_exit();
 }
 
 
 void TIM7_IRQHandler(void)
 {
+	trace_isr_enter();
 	tmr_irq_handler(7);
+	trace_isr_exit();
 }
 
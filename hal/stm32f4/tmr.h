@@ -100,6 +100,26 @@ typedef void (*tmr_update_cb_t)(tmr_t *tmr, void *param);
 void tmr_set_update_cb(tmr_t *tmr, tmr_update_cb_t cb, void *param);
 
 
+/**
+ * @brief add callback to run when a compare channel of the timer matches
+ * @param tmr timer to connect the callback
+ * @param cb callback function (NULL to disable the compare interrupt)
+ * @param channel which compare channel (TIM_Channel_1 .. TIM_Channel_4)
+ * @param param callback parameter
+ * @note the channel compare value is set by the user of the channel (see hrtimer)
+ */
+typedef void (*tmr_compare_cb_t)(tmr_t *tmr, int ch, void *param);
+void tmr_set_compare_cb(tmr_t *tmr, tmr_compare_cb_t cb, int channel, void *param);
+
+
+/**
+ * @brief get the clock frequency the timer counts at before the prescaler
+ * @param tmr the timer to get the clock of
+ * @return clock frequency in Hz
+ */
+uint32_t tmr_get_clk_freq(tmr_t *tmr);
+
+
 /**
  * @brief get the tick count of the timer
  * @param tmr the timer to get the tick count of
@@ -47,6 +47,9 @@ struct tmr_t
 
 	tmr_update_cb_t update_cb;
 	void *update_cb_param;
+
+	tmr_compare_cb_t compare_cb[4];
+	void *compare_cb_param[4];
 };
 
 #endif
@@ -0,0 +1,43 @@
+/**
+ * @file trace.c
+ *
+ * @brief implements the event trace recorder of the hal
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#include <string.h>
+#include "hal.h"
+
+
+// not static so the debugger can find it (see trace.h), it is in .bss and
+// trace_start fills in the header
+struct trace_ring_t trace_ring;
+
+
+void trace_start(void)
+{
+	trace_ring.on = 0;
+	trace_ring.magic = TRACE_MAGIC;
+	trace_ring.size = TRACE_RING_SIZE;
+	trace_ring.head = 0;
+	memset(trace_ring.rec, 0, sizeof(trace_ring.rec));
+	memory_barrier();
+	trace_ring.on = 1;
+}
+
+
+void trace_stop(void)
+{
+	trace_ring.on = 0;
+	memory_barrier();
+}
+
+
+void trace_send(uart_t *uart, uart_write_complete_cb cb)
+{
+	uart_write(uart, &trace_ring, sizeof(trace_ring), cb, NULL);
+}
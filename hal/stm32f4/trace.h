@@ -0,0 +1,177 @@
+/**
+ * @file trace.h
+ *
+ * @brief event trace recorder of the hal
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note with TRACE set to 1 the isr wrappers, sys_run (ie every scheduler
+ * task), the dma and the uart, spim and i2c drivers record what they are
+ * doing in a ring of fixed size records (cycle count, event and object), with
+ * TRACE 0 the hooks compile to nothing. Recording is lock free and the ring
+ * keeps the latest TRACE_RING_SIZE records, so leave it running and stop it
+ * (trace_stop) once the problem has happened. The ring is self describing so
+ * it can be saved from the debugger
+ *
+ *	(gdb) dump binary value trace.bin trace_ring
+ *
+ * or sent out of a uart (trace_send), and scripts/trace_json.py turns it into
+ * chrome trace json (chrome://tracing or ui.perfetto.dev)
+ *
+ */
+
+#ifndef __TRACE__
+#define __TRACE__
+
+#ifndef TRACE
+#define TRACE (0)
+#endif
+
+/**
+ * number of records kept (a power of 2)
+ */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE (1024)
+#endif
+
+#define TRACE_MAGIC (0x54524331)	// "TRC1"
+
+/**
+ * events, the object is the exception number for isrs, the callback address
+ * for tasks and the driver object (ie the uart_t) for the rest
+ */
+enum trace_event
+{
+	TRACE_ISR_ENTER = 1,
+	TRACE_ISR_EXIT,
+	TRACE_TASK_START,
+	TRACE_TASK_END,
+	TRACE_DMA_START,
+	TRACE_DMA_DONE,
+	TRACE_UART_READ,
+	TRACE_UART_READ_DONE,
+	TRACE_UART_WRITE,
+	TRACE_UART_WRITE_DONE,
+	TRACE_SPIM_XFER,
+	TRACE_SPIM_DONE,
+	TRACE_I2C_READ,
+	TRACE_I2C_READ_DONE,
+	TRACE_I2C_WRITE,
+	TRACE_I2C_WRITE_DONE,
+	TRACE_I2C_ERROR,
+	TRACE_USER					// user events, see trace_user
+};
+
+/**
+ * @brief a trace record, the event is in the top byte of what and the object
+ * in the low 24 bits (addresses are packed by trace_obj)
+ */
+struct trace_record_t
+{
+	uint32_t cycles;
+	uint32_t what;
+};
+
+/**
+ * @brief the trace ring, head counts every record written so the oldest is at
+ * head - TRACE_RING_SIZE once the ring has wrapped
+ */
+struct trace_ring_t
+{
+	uint32_t magic;
+	uint32_t size;
+	volatile uint32_t head;
+	volatile uint32_t on;
+	struct trace_record_t rec[TRACE_RING_SIZE];
+};
+
+extern struct trace_ring_t trace_ring;
+
+
+#if TRACE
+
+/**
+ * @brief record an event (safe from any isr priority, it doesn't mask interrupts)
+ * @param event event (see enum trace_event)
+ * @param obj object the event is about
+ */
+static inline void trace(uint32_t event, uint32_t obj)
+{
+	uint32_t head;
+	struct trace_record_t *r;
+
+	if (!trace_ring.on)
+		return;
+	do
+	{
+		head = load_exclusive(&trace_ring.head);
+	} while (store_exclusive(&trace_ring.head, head + 1));
+
+	r = &trace_ring.rec[head & (TRACE_RING_SIZE - 1)];
+	r->cycles = sys_cycle_stamp();
+	r->what = (event << 24) | (obj & 0xffffff);
+}
+
+// the exception number of the running isr
+#if defined(__arm__)
+static inline uint32_t trace_ipsr(void)
+{
+	uint32_t ipsr;
+	__asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+	return ipsr;
+}
+#else
+#define trace_ipsr() (0)
+#endif
+
+#define trace_isr_enter() trace(TRACE_ISR_ENTER, trace_ipsr())
+#define trace_isr_exit() trace(TRACE_ISR_EXIT, trace_ipsr())
+
+#else
+
+#define trace(event, obj)
+#define trace_isr_enter()
+#define trace_isr_exit()
+
+#endif
+
+/**
+ * @brief pack an address into a 24 bit trace object, the low 24 bits alone
+ * would mix up flash (0x08), ram (0x20) and the ccm (0x10), so the top nibble
+ * of the address goes in bits 21-23 (flash is 0) over a 2M offset in the
+ * region (see scripts/trace_json.py)
+ */
+#define trace_obj(p) ((((uint32_t)(uintptr_t)(p) >> 7) & 0xe00000) | ((uint32_t)(uintptr_t)(p) & 0x1fffff))
+
+
+/**
+ * @brief record a user event (shown as an instant event with the id)
+ * @param id user id (24 bits)
+ */
+#define trace_user(id) trace(TRACE_USER, id)
+
+
+/**
+ * @brief start recording (the ring is cleared)
+ * @note the ring is in .bss, its header (magic and size) is only set here
+ */
+void trace_start(void);
+
+
+/**
+ * @brief stop recording so the ring holds what led up to now
+ */
+void trace_stop(void);
+
+
+/**
+ * @brief send the ring out of a uart (stop the trace first)
+ * @param uart uart to send it out of (initialised and not in use)
+ * @param cb called when the ring has been sent
+ * @note a uart write is limited to 64K so TRACE_RING_SIZE can't be more than 8K
+ */
+void trace_send(uart_t *uart, uart_write_complete_cb cb);
+
+#endif
@@ -9,6 +9,8 @@
  *
  */
 
+#define SYS_LOCK_MODULE SYS_LOCK_UART
+
 #include <stm32f4xx_conf.h>
 #include "hal.h"
 #include "uart_hw.h"
@@ -93,6 +95,7 @@ static void uart_rx_dma_complete(dma_request_t *req, void *param)
 	void *read_complete_param = uart->read_complete_param;
 
 	uart_clear_read(uart);
+	trace(TRACE_UART_READ_DONE, trace_obj(uart));
 	if (read_complete_cb != NULL)
 		read_complete_cb(uart, buf, len, read_complete_param);
 }
@@ -107,12 +110,16 @@ static void uart_tx_dma_complete(dma_request_t *req, void *param)
 	void *write_complete_param = uart->write_complete_param;
 
 	uart_clear_write(uart);
+	trace(TRACE_UART_WRITE_DONE, trace_obj(uart));
 	if (write_complete_cb != NULL)
 		write_complete_cb(uart, buf, len, write_complete_param);
 }
 
 
-static void uart_irq_handler(uart_t *uart)
+// runs from ram with the handlers so the per byte work goes to the registers
+// rather than the st library (that is in flash), the clear at the end of a
+// read/write still goes through the library
+static ramfunc void uart_irq_handler(uart_t *uart)
 {
 	// buffer the current transaction so we can clear the uart ready for a new
 	// read/write before calling the completion routines (that was a complete
@@ -132,10 +139,10 @@ static void uart_irq_handler(uart_t *uart)
 		return;
 
 	// if the receive buffer is full copy it to read_buf
-	if (USART_GetITStatus(uart->channel, USART_IT_RXNE) &&
+	if ((uart->channel->CR1 & USART_CR1_RXNEIE) && (uart->channel->SR & USART_SR_RXNE) &&
 		uart->read_buf != NULL && uart->read_count < uart->read_buf_len)
 	{
-		uint16_t rx = USART_ReceiveData(uart->channel);
+		uint16_t rx = uart->channel->DR & 0x1ff;
 		uint32_t word_len = uart->cfg.USART_WordLength;
 
 		// copy received word into read_buf (if were using 8bits
@@ -151,12 +158,13 @@ static void uart_irq_handler(uart_t *uart)
 			read_count = uart->read_count;
 			read_complete_cb = uart->read_complete_cb;
 			uart_clear_read(uart);
+			trace(TRACE_UART_READ_DONE, trace_obj(uart));
 		}
 	}
 
 	// if the transmit buffer empty & do we have
 	// more to send then populate it
-	if (USART_GetITStatus(uart->channel, USART_IT_TXE) &&
+	if ((uart->channel->CR1 & USART_CR1_TXEIE) && (uart->channel->SR & USART_SR_TXE) &&
 		uart->write_buf != NULL && uart->write_count < uart->write_buf_len)
 	{
 		uint16_t tx;
@@ -170,18 +178,19 @@ static void uart_irq_handler(uart_t *uart)
 		else
 			tx = ((uint8_t *)uart->write_buf)[uart->write_count++];
 		if (uart->write_count == uart->write_buf_len)
-			USART_ITConfig(uart->channel, USART_IT_TC, ENABLE);
-		USART_SendData(uart->channel, tx);
+			uart->channel->CR1 |= USART_CR1_TCIE;
+		uart->channel->DR = tx & 0x1ff;
 	}
 
 	// if the transmitter completed the last byte then the write is done
-	if (USART_GetITStatus(uart->channel, USART_IT_TC) &&
+	if ((uart->channel->CR1 & USART_CR1_TCIE) && (uart->channel->SR & USART_SR_TC) &&
 		uart->write_buf != NULL && uart->write_count == uart->write_buf_len)
 	{
-		USART_ITConfig(uart->channel, USART_IT_TC, DISABLE);
+		uart->channel->CR1 &= ~USART_CR1_TCIE;
 		write_count = uart->write_count;
 		write_complete_cb = uart->write_complete_cb;
 		uart_clear_write(uart);
+		trace(TRACE_UART_WRITE_DONE, trace_obj(uart));
 	}
 
 	// run deferred read/write callbacks
@@ -192,30 +201,40 @@ static void uart_irq_handler(uart_t *uart)
 }
 
 
-void USART1_IRQHandler(void)
+ramfunc void USART1_IRQHandler(void)
 {
+	trace_isr_enter();
 	uart_irq_handler(uart_irq_list[0]);
+	trace_isr_exit();
 }
 
 
-void USART2_IRQHandler(void)
+ramfunc void USART2_IRQHandler(void)
 {
+	trace_isr_enter();
 	uart_irq_handler(uart_irq_list[1]);
+	trace_isr_exit();
 }
 
 
-void USART3_IRQHandler(void)
+ramfunc void USART3_IRQHandler(void)
 {
+	trace_isr_enter();
 	uart_irq_handler(uart_irq_list[2]);
+	trace_isr_exit();
 }
 
-void UART4_IRQHandler(void)
+ramfunc void UART4_IRQHandler(void)
 {
+	trace_isr_enter();
 	uart_irq_handler(uart_irq_list[3]);
+	trace_isr_exit();
 }
-void UART5_IRQHandler(void)
+ramfunc void UART5_IRQHandler(void)
 {
+	trace_isr_enter();
 	uart_irq_handler(uart_irq_list[4]);
+	trace_isr_exit();
 }
 
 #define UART_DMA_DIR_RX 0
@@ -252,17 +271,19 @@ static void uart_dma_cfg(uart_t *uart, int dir, dma_request_t *dma_req, void *bu
 }
 
 
-void uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param)
+int uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param)
 {
+	int ret = -1;
+	sys_lock_t lock;
+
 	// sanity checks
 	if (len < 1)
-		///@todo invalid input parameters
-		return;
+		return -1;
 
-	sys_enter_critical_section();   // lock while changing things so an isr does not find a half setup read
+	lock = sys_lock(SYS_LOCK_KERNEL);   // lock while changing things so an isr does not find a half setup read
 
 	if (uart->read_buf != NULL || uart->read_count != 0)
-		///@todo read in progress already
+		// read in progress already
 		goto done;
 
 	// load the read info
@@ -271,6 +292,7 @@ void uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb,
 	uart->read_count = 0;
 	uart->read_complete_cb = cb;
 	uart->read_complete_param = param;
+	trace(TRACE_UART_READ, trace_obj(uart));
 
 	// enable rx dma or interrupt to kick off the read
 	if (uart->rx_dma)
@@ -280,15 +302,26 @@ void uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb,
 		uart->rx_dma_req.dma = uart->rx_dma;
 		uart_dma_cfg(uart, UART_DMA_DIR_RX, &uart->rx_dma_req, uart->read_buf, uart->read_buf_len);
 		USART_DMACmd(uart->channel, USART_DMAReq_Rx, ENABLE);
-		dma_request(&uart->rx_dma_req);
+		if (dma_request(&uart->rx_dma_req) != 0)
+			goto dma_failed;
 	}
 	else
 	{
 		USART_ITConfig(uart->channel, USART_IT_RXNE, ENABLE);
 	}
+	ret = 0;
 done:
-	sys_leave_critical_section();
-	return;
+	sys_unlock(lock);
+	return ret;
+
+dma_failed:
+	// the dma can't reach buf (ie it is in the ccm), complete with nothing read
+	uart_clear_read(uart);
+	sys_unlock(lock);
+	trace(TRACE_UART_READ_DONE, trace_obj(uart));
+	if (cb != NULL)
+		cb(uart, buf, 0, param);
+	return 0;
 }
 
 
@@ -307,23 +340,27 @@ int uart_read_count(uart_t *uart)
 
 void uart_cancel_read(uart_t *uart)
 {
-	sys_enter_critical_section();
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
 	uart_clear_read(uart);
-	sys_leave_critical_section();
+	sys_unlock(lock);
 }
 
 
-void uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param)
+int uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param)
 {
+	int ret = -1;
+	sys_lock_t lock;
+
 	// sanity checks
 	if (len < 1)
-		///@todo invalid input parameters
-		return;
+		return -1;
 
-	sys_enter_critical_section();   // lock while changing things so an isr does not find a half setup write
+	lock = sys_lock(SYS_LOCK_KERNEL);   // lock while changing things so an isr does not find a half setup write
 
 	if (uart->write_buf != NULL || uart->write_count != 0)
-		///@todo write in progress already
+		// write in progress already
 		goto done;
 
 	// load the write info
@@ -332,6 +369,7 @@ void uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb
 	uart->write_count = 0;
 	uart->write_complete_cb = cb;
 	uart->write_complete_param = param;
+	trace(TRACE_UART_WRITE, trace_obj(uart));
 
 	// enable tx dma or interrupts to kick off the write
 	if (uart->tx_dma)
@@ -341,14 +379,25 @@ void uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb
 		uart->tx_dma_req.dma = uart->tx_dma;
 		uart_dma_cfg(uart, UART_DMA_DIR_TX, &uart->tx_dma_req, uart->write_buf, uart->write_buf_len);
 		USART_DMACmd(uart->channel, USART_DMAReq_Tx, ENABLE);
-		dma_request(&uart->tx_dma_req);
+		if (dma_request(&uart->tx_dma_req) != 0)
+			goto dma_failed;
 	}
 	else
 		USART_ITConfig(uart->channel, USART_IT_TXE, ENABLE);
+	ret = 0;
 
 done:
-	sys_leave_critical_section();
-	return;
+	sys_unlock(lock);
+	return ret;
+
+dma_failed:
+	// the dma can't reach buf (ie it is in the ccm), complete with nothing written
+	uart_clear_write(uart);
+	sys_unlock(lock);
+	trace(TRACE_UART_WRITE_DONE, trace_obj(uart));
+	if (cb != NULL)
+		cb(uart, buf, 0, param);
+	return 0;
 }
 
 
@@ -367,9 +416,11 @@ int uart_write_count(uart_t *uart)
 
 void uart_cancel_write(uart_t *uart)
 {
-	sys_enter_critical_section();
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
 	uart_clear_write(uart);
-	sys_leave_critical_section();
+	sys_unlock(lock);
 }
 
 void uart_deinit(uart_t *uart) 
@@ -440,7 +491,7 @@ void uart_init(uart_t *uart)
 	// setup the uart isr
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	nvic_init.NVIC_IRQChannel = uart_irq(uart);
-	nvic_init.NVIC_IRQChannelPreemptionPriority = uart->preemption_priority;
+	nvic_init.NVIC_IRQChannelPreemptionPriority = sys_isr_priority(uart->preemption_priority);
 	nvic_init.NVIC_IRQChannelSubPriority = 0;
 	nvic_init.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&nvic_init);
@@ -58,8 +58,12 @@ typedef void (*uart_write_complete_cb)(uart_t *uart, void *buf, uint16_t len, vo
  * @param len number of bytes in the buffer
  * @param cb completion callback
  * @param param parameter passed to the completion callback
+ * @return 0 if the write was started (or completed, see the note), -1 if it wasn't (len is 0 or a write is already
+ * in progress) and cb will not be called
+ * @note with a tx dma buf can't be in the ccm (the dma has no path to it), that includes
+ * the main stack so don't pass a local buffer, cb is called straight away with len 0
  */
-void uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param);
+int uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param);
 
 
 /**
@@ -93,8 +97,12 @@ typedef void (*uart_read_complete_cb)(uart_t *uart, void *buf, uint16_t len, voi
  * @param len number of bytes in the buffer
  * @param cb completion callback
  * @param param parameter passed to the completion callback
+ * @return 0 if the read was started (or completed, see the note), -1 if it wasn't (len is 0 or a read is already
+ * in progress) and cb will not be called
+ * @note with an rx dma buf can't be in the ccm (the dma has no path to it), that includes
+ * the main stack so don't pass a local buffer, cb is called straight away with len 0
  */
-void uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param);
+int uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param);
 
 
 /**
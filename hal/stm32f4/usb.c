@@ -313,6 +313,11 @@ static uint8_t usb_device_hid_data_out(void *pdev, uint8_t epnum)
     {
         // Mark the receive buffer as holding a packet
         usb_receive_buffer_full = 1;
+        // Let the reader know so it doesn't have to poll usb_hid_read
+        if (usb_configuration->received_cb)
+        {
+            usb_configuration->received_cb();
+        }
     }
     return USBD_OK;
 }
@@ -376,9 +381,8 @@ void USB_OTG_BSP_EnableInterrupt(USB_OTG_CORE_HANDLE *pdev)
 {
   NVIC_InitTypeDef NVIC_InitStructure;
 
-  NVIC_PriorityGroupConfig(NVIC_PriorityGroup_1);
   NVIC_InitStructure.NVIC_IRQChannel = OTG_FS_IRQn;
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 4;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = sys_isr_priority(4);
   NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&NVIC_InitStructure);
@@ -408,7 +412,9 @@ void USB_OTG_BSP_mDelay (const uint32_t msec)
 
 void OTG_FS_IRQHandler(void)
 {
+    trace_isr_enter();
     USBD_OTG_ISR_Handler(&usb_dev_handle);
+    trace_isr_exit();
 }
 
 // Interface functions
@@ -160,6 +160,7 @@ typedef struct
     void (*resumed_cb)(void);
     void (*connected_cb)(void);
     void (*disconnected_cb)(void);
+    void (*received_cb)(void);      // An out report is ready for usb_hid_read (called from the usb isr)
 } usb_config_t;
 
 usb_dev_handle_t usb_init(usb_config_t *usb_config);
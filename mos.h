@@ -14,6 +14,9 @@
 
 #include "hal/hal.h"
 #include "sched/sched.h"
+#include "sched/sched_co.h"
+#include "sched/sched_event.h"
+#include "sched/sched_thread.h"
 
 #endif
 
@@ -10,65 +10,406 @@
  */
 
 
+#define SYS_LOCK_MODULE SYS_LOCK_SCHED
+
 #include <string.h>
 #include <hal.h>
 #include "sched.h"
+#include "sched_tq.h"
+#include "sched_wait.h"
+#include "sched_profile.h"
+#include "sched_co.h"
+#include "sched_thread.h"
+
+/* a task id is the slot of the task in task_list plus a generation count
+ * for that slot, the generation is bumped every time the slot is freed so a
+ * stale id (one for a task that has already run or been removed) will not
+ * match the task now using the slot */
+#define TASK_SLOT_BITS (16)
+#define TASK_SLOT_MASK ((1 << TASK_SLOT_BITS) - 1)
+#define TASK_SLOT(id) ((id) & TASK_SLOT_MASK)
+#define TASK_GEN(id) ((id) >> TASK_SLOT_BITS)
+#define TASK_ID(slot, gen) ((task_id_t)(((gen) << TASK_SLOT_BITS) | (slot)))
+
+// the all ones slot is never valid so an id can never be -1 (the error return)
+#if SCHED_MAX_TASKS > TASK_SLOT_MASK
+#error "SCHED_MAX_TASKS is too big for the task id slot"
+#endif
+
+#if SCHED_CTX_SIZE > 255
+#error "SCHED_CTX_SIZE must fit in the task argc"
+#endif
+
+#if SCHED_PRIORITIES > 32
+#error "SCHED_PRIORITIES must fit in the 32 bit ready map"
+#endif
+
+/* the task pool is the static array unless sched_init_pool gives it other memory,
+ * only the base and size change so the pool costs the same either way */
+static struct task_info_t task_static[SCHED_MAX_TASKS] SCHED_MEM;
+static struct task_info_t *task_list = task_static;
+static void *tq_mem = NULL;						// backend memory for a user pool (NULL for the static one)
+static struct task_info_t *free_list = NULL;	// free tasks linked through next so alloc is O(1)
+static struct sched_pool_stats_t pool;
+
+#if SCHED_SLACK
+/* a slack task can run any time from its time to its time + slack. It is put in
+ * the time queue at the end of its window, so the next wakeup is the earliest
+ * window end, and on the slack list in start order, so it also runs at any
+ * earlier wakeup once its window has started */
+static struct task_info_t *slack_list = NULL;
+static uint32_t saved_wakeups = 0;
+#endif
+
+/* late tasks are moved out of the time queue into a fifo per priority, the
+ * fifos are kept in time order so equal priority tasks run oldest first. A bit
+ * is set in map for each priority with ready tasks so the next task to run is
+ * found with a single clz */
+struct ready_t
+{
+	uint32_t map;
+	struct task_info_t *head[SCHED_PRIORITIES], *tail[SCHED_PRIORITIES];
+};
+static struct ready_t ready SCHED_MEM;
 
-struct task_info_t
+#if SCHED_POST_SIZE & (SCHED_POST_SIZE - 1)
+#error "SCHED_POST_SIZE must be a power of 2"
+#endif
+
+/* tasks posted from isrs go in a ring instead of the task queue so isrs never
+ * disable interrupts or walk the queue. Producers claim a slot by moving head
+ * on with ldrex/strex (so nested isrs are safe), fill it and then mark it full.
+ * Only sched_run_tasks consumes, it moves tail on once a slot is drained */
+struct post_t
 {
-	task_id_t task_id;
 	uint32_t time;
-	int priority;
 	void *cb;
+	uint8_t priority;
 	uint8_t argc;
 	uint32_t argv[SCHED_MAX_TASK_PARAMS];
-	struct task_info_t *next, *prev;	// double link list for speed
+	volatile uint8_t full;
+};
+struct post_ring_t
+{
+	volatile uint32_t head, tail;
+	struct post_t slot[SCHED_POST_SIZE];
 };
+static struct post_ring_t post SCHED_MEM;
 
-static struct task_info_t task_list[SCHED_MAX_TASKS];
-static struct task_info_t *task_list_head = NULL;
-static task_id_t task_id = 0; // global task id index (incremented so no tasks should have the same id)
+// late tasks detached by sched_run_for, in the order they will run
+static struct task_info_t *batch_head = NULL, *batch_tail = NULL;
 
 
 static struct task_info_t * alloc_task()
 {
-	int t;
+	struct task_info_t *task = free_list;
 
-	for (t = 0; t < SCHED_MAX_TASKS; t++)
+	// a null free list means all the tasks are in use
+	if (task)
 	{
-		if (task_list[t].cb == NULL)
-			// a null callback indicates this is a free task
-			return &task_list[t];
+		free_list = task->next;
+		if (++pool.used > pool.used_max)
+			pool.used_max = pool.used;
 	}
+	else
+		pool.failures++;
 
-	// task not found
-	return NULL;
+	return task;
 }
 
 static void free_task(struct task_info_t *task)
 {
+	// the next id for this slot is stored in the free task ready for alloc
+	task_id_t id = task->task_id;
+
 	memset(task, 0, sizeof(*task));
+	task->task_id = TASK_ID(TASK_SLOT(id), TASK_GEN(id) + 1);
+	task->state = TASK_FREE;
+	task->next = free_list;
+	free_list = task;
+	pool.used--;
+}
+
+// find the task with this id (NULL if it is not queued or the id is stale)
+static struct task_info_t * find_task(task_id_t id)
+{
+	struct task_info_t *task;
+
+	if (TASK_SLOT(id) >= pool.size)
+		return NULL;
+
+	// a null callback indicates this is a free task
+	task = &task_list[TASK_SLOT(id)];
+	if (task->cb == NULL || task->task_id != id)
+		return NULL;
+
+	return task;
+}
+
+#if SCHED_POLICY == SCHED_POLICY_EDF
+// under edf every task is on one ready queue in absolute deadline order
+#define ready_level(task) (0)
+#define ready_key(task) ((task)->time + (task)->deadline)
+#else
+// ready queue level for a task (priorities above the top level share it)
+static int ready_level(struct task_info_t *task)
+{
+	return task->priority < SCHED_PRIORITIES ? task->priority : SCHED_PRIORITIES - 1;
+}
+#define ready_key(task) ((task)->time)
+#endif
+
+// add a late task to its ready queue (searching back from the tail keeps the
+// queue in time (or deadline) order, late tasks normally arrive in that order
+// so this is O(1))
+static void ready_push(struct task_info_t *task)
+{
+	int p = ready_level(task);
+	struct task_info_t *t;
+
+	for (t = ready.tail[p]; t; t = t->prev)
+		if (sys_tick_diff(ready_key(t), ready_key(task)) >= 0)
+			break;
+
+	task->prev = t;
+	task->next = t ? t->next : ready.head[p];
+	if (task->next)
+		task->next->prev = task;
+	else
+		ready.tail[p] = task;
+	if (t)
+		t->next = task;
+	else
+		ready.head[p] = task;
+
+	task->state = TASK_READY;
+	ready.map |= 1ul << p;
+}
+
+static void ready_remove(struct task_info_t *task)
+{
+	int p = ready_level(task);
+
+	if (task->prev)
+		task->prev->next = task->next;
+	else
+		ready.head[p] = task->next;
+	if (task->next)
+		task->next->prev = task->prev;
+	else
+		ready.tail[p] = task->prev;
+	task->next = task->prev = NULL;
+
+	if (ready.head[p] == NULL)
+		ready.map &= ~(1ul << p);
+}
+
+// the oldest task at the highest ready priority (NULL if none are ready)
+static struct task_info_t * ready_peek(void)
+{
+	if (ready.map == 0)
+		return NULL;
+	return ready.head[31 - count_leading_zeros(ready.map)];
+}
+
+#if SCHED_EVENTS
+// take a task off the event or queue wait list it is on
+static void wait_unlink(struct task_info_t *task)
+{
+	struct task_info_t **p;
+
+	for (p = task->wait_list; *p != task; p = &(*p)->wait_next);
+	*p = task->wait_next;
+	task->wait_list = NULL;
+	task->wait_next = NULL;
+}
+#endif
+
+#if SCHED_SLACK
+// take a task off the slack list
+static void slack_unlink(struct task_info_t *task)
+{
+	struct task_info_t **p;
+
+	for (p = &slack_list; *p != task; p = &(*p)->slack_next);
+	*p = task->slack_next;
+	task->slack_next = NULL;
+}
+#endif
+
+// move all the late tasks out of the time queue on to the ready queues
+static void ready_late_tasks(uint32_t now)
+{
+	struct task_info_t *t;
+	int n = 0;
+
+#if SCHED_SLACK
+	int slack = 0;
+
+	// slack tasks whose window has started share this wakeup (a slack task is
+	// always taken from here before it is late in the time queue)
+	while ((t = slack_list) != NULL && sys_tick_diff(t->time - t->slack, now) >= 0)
+	{
+		slack_list = t->slack_next;
+		t->slack_next = NULL;
+		tq_remove(t);
+		t->time -= t->slack;
+		t->slack = 0;
+		ready_push(t);
+		n++;
+		slack++;
+	}
+#endif
+
+	while ((t = tq_pop_late(now)) != NULL)
+	{
+		n++;
+#if SCHED_EVENTS
+		// a waiting task that timed out runs with a 0 value
+		if (t->wait_list)
+		{
+			wait_unlink(t);
+			t->argv[1] = 0;
+		}
+#endif
+		ready_push(t);
+	}
+
+#if SCHED_SLACK
+	// each slack task that ran along with another task saved a wakeup
+	if (slack)
+		saved_wakeups += slack < n ? slack : n - 1;
+#endif
 }
 
-// insert task between a and b
-static void insert_task(struct task_info_t *a, struct task_info_t *b, struct task_info_t *task)
+// alloc a task and add it to the time queue (call from a critical section)
+static struct task_info_t * add_task(uint32_t time, uint8_t priority, void *callback, uint8_t argc, uint32_t argv[])
 {
-	if (a)
-		a->next = task;
-	if (b)
-		b->prev = task;
-	task->prev = a;
-	task->next = b;
-	if (!task_list_head || b == task_list_head)
-		task_list_head = task;
+	struct task_info_t *new_task;
+
+	// alloc[find] a new free task to use
+	new_task = alloc_task();
+	if (!new_task)
+	{
+		sched_pool_exhausted(callback);
+		return NULL;
+	}
+
+	// populate task info (the task id was set up when the task was freed)
+	new_task->time = time;
+	new_task->priority = priority;
+	new_task->cb = callback;
+	new_task->argc = argc;
+	memcpy(new_task->argv, argv, argc * sizeof(argv[0]));
+
+	// hand the task to the time queue backend to order it
+	new_task->state = TASK_TIMED;
+	tq_insert(new_task);
+
+	return new_task;
 }
 
+// move the tasks posted from isrs into the time queue (call from a critical
+// section), a task that cannot be allocated is left in the ring for next time
+static void drain_posts(void)
+{
+	while (post.tail != post.head)
+	{
+		struct post_t *p = &post.slot[post.tail & (SCHED_POST_SIZE - 1)];
+
+		// the slot is claimed but the isr has not finished filling it
+		if (!p->full)
+			break;
+		if (!add_task(p->time, p->priority, p->cb, p->argc, p->argv))
+			break;
+
+		p->full = 0;
+		memory_barrier();
+		post.tail++;
+	}
+}
+
+// unlink a task from the sched_run_for batch
+static void batch_remove(struct task_info_t *t)
+{
+	if (t->prev)
+		t->prev->next = t->next;
+	else
+		batch_head = t->next;
+	if (t->next)
+		t->next->prev = t->prev;
+	else
+		batch_tail = t->prev;
+	t->next = t->prev = NULL;
+}
+
+// remove a queued task from whichever queue it is on and free it
+static void rm_task(struct task_info_t *t)
+{
+#if SCHED_EVENTS
+	if (t->wait_list)
+		wait_unlink(t);
+#endif
+#if SCHED_SLACK
+	if (t->slack)
+		slack_unlink(t);
+#endif
+	if (t->state == TASK_READY)
+		ready_remove(t);
+	else if (t->state == TASK_BATCH)
+		batch_remove(t);
+	else if (t->state == TASK_TIMED)
+		tq_remove(t);
+	free_task(t);
+}
+
+#if SCHED_EVENTS
+struct task_info_t * wait_add(struct task_info_t **list, uint32_t timeout, uint8_t priority, void *callback, uint32_t arg, uint32_t data)
+{
+	struct task_info_t *t, **p;
+	uint32_t argv[2] = {arg, data};
+
+	t = add_task(SCHED_CLOCK() + timeout, priority, callback, 2, argv);
+	if (!t)
+		return NULL;
+
+	// with no timeout only a wake can make it ready
+	if (timeout == 0)
+	{
+		tq_remove(t);
+		t->state = TASK_WAITING;
+	}
+
+	// wake in the order the tasks started waiting
+	for (p = list; *p; p = &(*p)->wait_next);
+	*p = t;
+	t->wait_list = list;
+	t->wait_next = NULL;
+
+	return t;
+}
+
+void wait_wake(struct task_info_t *task, uint32_t value)
+{
+	wait_unlink(task);
+	if (task->state == TASK_TIMED)
+		tq_remove(task);
+
+	// it is ready now, behind the tasks that were already late
+	task->time = SCHED_CLOCK();
+	task->argv[1] = value;
+	ready_push(task);
+}
+#endif
+
 task_id_t sched_add_task(uint32_t time, uint8_t priority, void *callback, uint8_t argc, ...)
 {
-	struct task_info_t *new_task, *prev_task, *task;
+	struct task_info_t *new_task;
+	uint32_t argv[SCHED_MAX_TASK_PARAMS];
 	uint8_t k;
 	va_list ap;
 	task_id_t ret = -1;
+	sys_lock_t lock;
 
 	// sanity checks on task
 	if (callback == NULL)
@@ -76,113 +417,304 @@ task_id_t sched_add_task(uint32_t time, uint8_t priority, void *callback, uint8_
 	if (argc < 0 || argc > SCHED_MAX_TASK_PARAMS)
 		return -1;
 
+	va_start(ap, argc);
+	for (k=0; k < argc; k++)
+		argv[k] = va_arg(ap, uint32_t);
+	va_end(ap);
+
 	// protect task_list with critical section
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	new_task = add_task(time, priority, callback, argc, argv);
+	if (new_task)
+		ret = new_task->task_id;
+
+	sys_unlock(lock);
+
+	return ret;
+}
+
+task_id_t sched_add_task_ctx(uint32_t time, uint8_t priority, sched_ctx_cb_t callback, const void *payload, size_t len)
+{
+	struct task_info_t *new_task;
+	task_id_t ret = -1;
+	sys_lock_t lock;
+
+	if (callback == NULL || len > SCHED_CTX_SIZE)
+		return -1;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	new_task = add_task(time, priority, callback, 0, NULL);
+	if (new_task)
+	{
+		new_task->ctx = 1;
+		new_task->argc = len;
+		memcpy(new_task->argv, payload, len);
+		ret = new_task->task_id;
+	}
+
+	sys_unlock(lock);
+
+	return ret;
+}
+
+#if SCHED_SLACK
+task_id_t sched_add_task_slack(uint32_t time, uint32_t slack, uint8_t priority, void *callback, uint8_t argc, ...)
+{
+	struct task_info_t *new_task, **p;
+	uint32_t argv[SCHED_MAX_TASK_PARAMS];
+	uint8_t k;
+	va_list ap;
+	task_id_t ret = -1;
+	sys_lock_t lock;
+
+	// sanity checks on task
+	if (callback == NULL)
+		return -1;
+	if (argc > SCHED_MAX_TASK_PARAMS)
+		return -1;
 
-	// alloc[find] a new free task to use
-	new_task = alloc_task();
-	if (!new_task)
-		goto done;
-	
-	// populate task info
-	memset(new_task, 0, sizeof(*new_task));
-	new_task->task_id = task_id++; // set this to the next global id and inc the global id
-	new_task->time = time;
-	new_task->priority = priority;
-	new_task->cb = callback;
-	new_task->argc = argc;
 	va_start(ap, argc);
 	for (k=0; k < argc; k++)
-		new_task->argv[k] = va_arg(ap, uint32_t);
+		argv[k] = va_arg(ap, uint32_t);
 	va_end(ap);
 
-	// find where this task should go in the task
-	// link list (it is ordered by time where the 
-	// first task is the next to run)
-	for (prev_task = NULL, task = task_list_head; task; prev_task = task, task = task->next)
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	new_task = add_task(time + slack, priority, callback, argc, argv);
+	if (new_task)
 	{
-		if (sys_tick_diff(time, task->time) > 0)
-			// task runs later than the new_task so we want to prepend new_task
-			break;
+		// keep the slack list in start order (oldest first for equal starts)
+		if (slack)
+		{
+			new_task->slack = slack;
+			for (p = &slack_list; *p && sys_tick_diff((*p)->time - (*p)->slack, time) >= 0; p = &(*p)->slack_next);
+			new_task->slack_next = *p;
+			*p = new_task;
+		}
+		ret = new_task->task_id;
 	}
-	
-	// insert this task into the task_list
-	if (!task_list_head)
-		// only task in the list
-		insert_task(prev_task, task, new_task); // NULL, NULL, new_task
-	else if (!task)
-		// last task in the list
-		insert_task(prev_task, task, new_task); // prev_task, NULL, new_task
-	else
-		// in the middle of the list somewhere
-		insert_task(prev_task, task, new_task); // prev_task, task, new_task
-	ret = new_task->task_id;
-	
-done:
-	sys_leave_critical_section();
+
+	sys_unlock(lock);
+
+	return ret;
+}
+
+uint32_t sched_get_saved_wakeups(void)
+{
+	return saved_wakeups;
+}
+#endif
+
+task_id_t sched_add_periodic(uint32_t period, uint32_t phase, uint8_t priority, void *callback, uint8_t argc, ...)
+{
+	struct task_info_t *new_task;
+	uint32_t argv[SCHED_MAX_TASK_PARAMS];
+	uint8_t k;
+	va_list ap;
+	task_id_t ret = -1;
+	sys_lock_t lock;
+
+	// sanity checks on task
+	if (callback == NULL || period == 0)
+		return -1;
+	if (argc > SCHED_MAX_TASK_PARAMS)
+		return -1;
+
+	va_start(ap, argc);
+	for (k=0; k < argc; k++)
+		argv[k] = va_arg(ap, uint32_t);
+	va_end(ap);
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	new_task = add_task(SCHED_CLOCK() + phase, priority, callback, argc, argv);
+	if (new_task)
+	{
+		new_task->period = period;
+#if SCHED_POLICY == SCHED_POLICY_EDF
+		new_task->deadline = period;
+#endif
+		ret = new_task->task_id;
+	}
+
+	sys_unlock(lock);
+
+	return ret;
+}
+
+int sched_get_overruns(task_id_t task)
+{
+	struct task_info_t *t;
+	int ret = -1;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	t = find_task(task);
+	if (t)
+		ret = t->overruns;
+	sys_unlock(lock);
 
 	return ret;
 }
 
+int sched_post_from_isr(uint32_t time, uint8_t priority, void *callback, uint8_t argc, ...)
+{
+	struct post_t *p;
+	uint32_t head;
+	uint8_t k;
+	va_list ap;
+
+	// sanity checks on task
+	if (callback == NULL)
+		return 0;
+	if (argc > SCHED_MAX_TASK_PARAMS)
+		return 0;
+
+	// claim the slot at head, retry if another isr got in between the ldrex and strex
+	do
+	{
+		head = load_exclusive(&post.head);
+		if (head - post.tail >= SCHED_POST_SIZE)
+		{
+			// the ring is full
+			clear_exclusive();
+			return 0;
+		}
+	} while (store_exclusive(&post.head, head + 1));
+
+	// the slot is ours until it is marked full and drained
+	p = &post.slot[head & (SCHED_POST_SIZE - 1)];
+	p->time = time;
+	p->priority = priority;
+	p->cb = callback;
+	p->argc = argc;
+	va_start(ap, argc);
+	for (k=0; k < argc; k++)
+		p->argv[k] = va_arg(ap, uint32_t);
+	va_end(ap);
+
+	// make sure the task is written before it is marked full
+	memory_barrier();
+	p->full = 1;
+
+	return 1;
+}
+
 int sched_rm_task(task_id_t task)
 {	
-	struct task_info_t *t, *prev, *next;
+	struct task_info_t *t;
 	int ret = 0;
+	sys_lock_t lock;
 
-	sys_enter_critical_section();
+	lock = sys_lock(SYS_LOCK_KERNEL);
 
 	// find the task in the task list
-	for (t = task_list_head; t; t = t->next)
-	{
-		if (t->task_id == task)
-			// task id found in list
-			break;
-	}
-	if (t->task_id != task)
+	t = find_task(task);
+	if (!t)
 		goto done; // task not in list
 
-	// remove the task from the list
-	prev = t->prev;
-	next = t->next;
-	if (prev)
-		prev->next = t->next;
-	if (next)
-		next->prev = t->prev;
-	if (t == task_list_head)
-		// if we are removing the head then we need to update it
-		task_list_head = next;
-	
-	// free the task
-	free_task(t);
+	rm_task(t);
 	ret = 1;
 
 done:
-	sys_leave_critical_section();
+	sys_unlock(lock);
 	return ret;
 }
 
-// find the next task to run, ie highest priority task out of all the late tasks
-struct task_info_t * get_next_late_task(void)
+int sched_rm_periodic(void *callback)
 {
-	struct task_info_t *t = NULL, *next = NULL;
-	uint32_t now;
+	int k, n = 0;
+	sys_lock_t lock;
 
-	sys_enter_critical_section();
-	now = sys_get_tick();
-	for (t = task_list_head; t; t = t->next)
+	// a scan of all the slots, bulk removal is rare so it does not need an index
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	for (k = 0; k < pool.size; k++)
 	{
-		if (sys_tick_diff(now, t->time) > 0)
-			// since task list is sorted by time all tasks after this
-			// are not yet late so we are done
-			break;
+		struct task_info_t *t = &task_list[k];
+		if (t->cb && t->period && (callback == NULL || t->cb == callback))
+		{
+			rm_task(t);
+			n++;
+		}
+	}
+	sys_unlock(lock);
+
+	return n;
+}
+
+// put a periodic task that is about to run back in the time queue at its next
+// release (counting from the last release, not now, so it does not drift)
+static void requeue_periodic(struct task_info_t *t, uint32_t now)
+{
+	int32_t behind;
+
+	t->time += t->period;
+
+	// skip any releases that have already been missed
+	behind = sys_tick_diff(t->time, now);
+	if (behind > 0)
+	{
+		uint32_t skip = (behind + t->period - 1) / t->period;
+		t->time += skip * t->period;
+		t->overruns += skip;
+	}
 
-		if (next == NULL || t->priority > next->priority)
-			// this task is late and has the highest priority so far
-			next = t;
+	t->state = TASK_TIMED;
+	tq_insert(t);
+}
+
+// find the next task to run, ie highest priority task out of all the late tasks,
+// copy it to task and remove it from the task list (return 0 if there are no late tasks),
+// periodic tasks are re-queued for their next release instead of being removed
+static int pop_next_late_task(struct task_info_t *task)
+{
+	struct task_info_t *t;
+	uint32_t now;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	now = SCHED_CLOCK();
+	drain_posts();
+	ready_late_tasks(now);
+	t = ready_peek();
+	if (t)
+	{
+		*task = *t;
+		ready_remove(t);
+		if (t->period)
+			requeue_periodic(t, now);
+		else
+			free_task(t);
 	}
-	sys_leave_critical_section();
+	sys_unlock(lock);
+
+	return t != NULL;
+}
+
+// call a task's callback, a payload is passed by pointer to the copy in task (which
+// the caller keeps until the callback returns)
+static void call_task(struct task_info_t *task)
+{
+	if (task->ctx)
+		((sched_ctx_cb_t)task->cb)(task->argv, task->argc);
+	else
+		sys_run(task->cb, task->argc, task->argv);
+}
 
-	return next;
+// run a task that has been taken off the queue
+static void run_task(struct task_info_t *task)
+{
+#if SCHED_PROFILE
+	uint32_t late = sys_tick_diff(task->time, SCHED_CLOCK());
+	uint32_t start = sys_get_cycles();
+
+	call_task(task);
+	profile_run(task->cb, late, sys_get_cycles() - start);
+#else
+	call_task(task);
+#endif
 }
 
 int sched_run_tasks(int empty)
@@ -191,19 +723,21 @@ int sched_run_tasks(int empty)
 
 	while (1)
 	{
-		struct task_info_t task, *t;
+		struct task_info_t task;
+
+		// resume the woken coroutines first, including any woken by the last
+		// task (in run one mode a coroutine counts as the one)
+		n += co_run_queued(empty ? 0 : 1);
+		if (n && !empty)
+			return n;
 
-		// find the next highest priority late task if there is one
-		t = get_next_late_task();
-		if (!t)
+		// find the next highest priority late task if there is one, save
+		// it and remove it from the list
+		if (!pop_next_late_task(&task))
 			return n; // no late tasks
 		
-		// save this task and remove it from the list
-		task = *t;
-		sched_rm_task(t->task_id);
-		
 		// run the task
-		sys_run(task.cb, task.argc, task.argv);
+		run_task(&task);
 		n++;
 
 		// option to run just one task at a time, or until no late tasks remain
@@ -212,8 +746,268 @@ int sched_run_tasks(int empty)
 	}
 }
 
+// move all the ready tasks on to the batch list in the order they will run (highest
+// priority first) leaving the ready queues empty (call from a critical section)
+static void batch_detach(void)
+{
+	struct task_info_t *t;
+
+	while (ready.map)
+	{
+		int p = 31 - count_leading_zeros(ready.map);
+
+		// splice the whole priority level on to the end of the batch
+		for (t = ready.head[p]; t; t = t->next)
+			t->state = TASK_BATCH;
+		ready.head[p]->prev = batch_tail;
+		if (batch_tail)
+			batch_tail->next = ready.head[p];
+		else
+			batch_head = ready.head[p];
+		batch_tail = ready.tail[p];
+		ready.head[p] = ready.tail[p] = NULL;
+		ready.map &= ~(1ul << p);
+	}
+}
+
+// take the first task off the batch, copy it to task and free (or re-queue) it
+static int batch_pop(struct task_info_t *task)
+{
+	struct task_info_t *t;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	t = batch_head;
+	if (t)
+	{
+		*task = *t;
+		batch_remove(t);
+		if (t->period)
+			requeue_periodic(t, SCHED_CLOCK());
+		else
+			free_task(t);
+	}
+	sys_unlock(lock);
+
+	return t != NULL;
+}
+
+// longest budget sched_run_for can time with the 32 bit cycle counter (about 12s at 168MHz)
+#define SCHED_RUN_FOR_MAX_CYCLES (0x7fffffff)
+
+int sched_run_for(uint32_t budget_us)
+{
+	uint32_t start = sys_get_cycles();
+	uint64_t cycles = (uint64_t)budget_us * (sys_clk_freq() / 1000000);
+	uint32_t budget = cycles > SCHED_RUN_FOR_MAX_CYCLES ? SCHED_RUN_FOR_MAX_CYCLES : cycles;
+	struct task_info_t task, *t;
+	int co = co_run_queued(0), n = 0;
+	sys_lock_t lock;
+
+	// detach every task that is late now in one go
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	drain_posts();
+	ready_late_tasks(SCHED_CLOCK());
+	batch_detach();
+	sys_unlock(lock);
+
+	// always run at least one task (the coroutines don't count) so a small
+	// budget still makes progress
+	while ((n == 0 || sys_get_cycles() - start < budget) && batch_pop(&task))
+	{
+		run_task(&task);
+		n++;
+	}
+
+	// out of time, put the rest back on the ready queues
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	while ((t = batch_head) != NULL)
+	{
+		batch_remove(t);
+		ready_push(t);
+	}
+	sys_unlock(lock);
+
+	return co + n;
+}
+
+int sched_next_deadline(uint32_t *tick)
+{
+	int ret = 1;
+	sys_lock_t lock;
+#if SCHED_THREADS
+	uint32_t wake;
+#endif
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	if (ready.map || post.head != post.tail || co_queued())
+		// there is work to do right now
+		*tick = SCHED_CLOCK();
+	else
+		ret = tq_next_time(tick);
+#if SCHED_THREADS
+	// a sleeping thread is woken by the tick, don't idle past it either
+	if (thread_next_wake(&wake) && (!ret || sys_tick_diff(wake, *tick) > 0))
+	{
+		*tick = wake;
+		ret = 1;
+	}
+#endif
+	sys_unlock(lock);
+
+	return ret;
+}
+
+#if SCHED_POLICY == SCHED_POLICY_EDF
+int sched_set_deadline(task_id_t task, uint32_t deadline)
+{
+	struct task_info_t *t;
+	int ret = 0;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	t = find_task(task);
+	if (!t)
+		goto done;
+
+	t->deadline = deadline;
+	// a ready task moves to its new place in the deadline order
+	if (t->state == TASK_READY)
+	{
+		ready_remove(t);
+		ready_push(t);
+	}
+	ret = 1;
+
+done:
+	sys_unlock(lock);
+	return ret;
+}
+
+int sched_edf_admit(const struct sched_edf_task_t *tasks, int n, uint32_t *load)
+{
+	uint64_t cycles_per_tick = sys_clk_freq() / SCHED_CLOCK_HZ;
+	uint64_t total = 0;
+	int k, ret = 1;
+
+	for (k = 0; k < n; k++)
+	{
+		uint64_t cycles = tasks[k].cycles;
+		uint32_t window = tasks[k].period;
+
+		if (tasks[k].deadline && tasks[k].deadline < window)
+			window = tasks[k].deadline;
+
+#if SCHED_PROFILE
+		// use the longest run measured so far
+		if (cycles == 0)
+		{
+			struct sched_cb_profile_t cb;
+			int j;
+
+			for (j = 0; j < SCHED_PROFILE_CBS; j++)
+				if (sched_get_cb_profile(j, &cb) && cb.cb == tasks[k].cb)
+				{
+					cycles = cb.cycles_max;
+					break;
+				}
+		}
+#endif
+		// a task that has never run (or has no period) can't be checked
+		if (cycles == 0 || window == 0)
+			ret = 0;
+		else
+		{
+			// round up so a set that only just overloads is rejected
+			uint64_t per = window * cycles_per_tick;
+			total += (cycles * 1000 + per - 1) / per;
+		}
+	}
+
+	if (total > 1000)
+		ret = 0;
+	*load = total > 0xffffffff ? 0xffffffff : (uint32_t)total;
+	return ret;
+}
+#endif
+
+weak void sched_pool_exhausted(void *callback)
+{
+}
+
+void sched_get_pool_stats(struct sched_pool_stats_t *stats)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	*stats = pool;
+	sys_unlock(lock);
+}
+
+int sched_init_pool(void *mem, size_t bytes)
+{
+	sys_lock_t lock;
+
+	// 8 byte align the pool, the backend memory follows the tasks
+	uintptr_t start = ((uintptr_t)mem + 7) & ~(uintptr_t)7;
+	size_t n;
+
+	if (mem == NULL)
+	{
+		// back to the static pool
+		lock = sys_lock(SYS_LOCK_KERNEL);
+		task_list = task_static;
+		tq_mem = NULL;
+		sys_unlock(lock);
+		sched_init();
+		return SCHED_MAX_TASKS;
+	}
+	if (bytes < start - (uintptr_t)mem)
+		return 0;
+	n = (bytes - (start - (uintptr_t)mem)) / (sizeof(struct task_info_t) + TQ_TASK_BYTES);
+	if (n > TASK_SLOT_MASK)
+		n = TASK_SLOT_MASK;
+	if (n == 0)
+		return 0;
+
+	// fresh memory has no slot generations to keep
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	task_list = (struct task_info_t *)start;
+	memset(task_list, 0, n * sizeof(struct task_info_t));
+	tq_mem = TQ_TASK_BYTES ? &task_list[n] : NULL;
+	pool.size = n;
+	sys_unlock(lock);
+
+	sched_init();
+	return n;
+}
+
 void sched_init(void)
 {
-	memset(task_list, 0, sizeof(task_list));
+	int t;
+
+	if (task_list == task_static)
+		pool.size = SCHED_MAX_TASKS;
+
+	// keep the slot generations so ids from before a re-init stay stale
+	free_list = NULL;
+	for (t = pool.size - 1; t >= 0; t--)
+	{
+		task_list[t].task_id = TASK_ID(t, TASK_GEN(task_list[t].task_id));
+		free_task(&task_list[t]);
+	}
+	pool.used = pool.used_max = pool.failures = 0;
+	memset(&ready, 0, sizeof(ready));
+	memset(&post, 0, sizeof(post));
+	batch_head = batch_tail = NULL;
+#if SCHED_SLACK
+	slack_list = NULL;
+	saved_wakeups = 0;
+#endif
+	tq_init(tq_mem, pool.size);
+#if SCHED_PROFILE
+	profile_init();
+#endif
 }
 
@@ -9,11 +9,13 @@
  *
  * @note: all tasks are soft tasks and are run to completion, if a task is
  * blocked by another task it will require the blocking task to complete,
- * once complete all late tasks are run in order of their priorities.
+ * once complete all late tasks are run in order of their priorities. Coroutines
+ * (see sched_co.h) are resumed by sched_run_tasks before any tasks are run.
  *
  */
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifndef __SCHED__
@@ -27,21 +29,219 @@
 #define SCHED_MAX_TASK_PARAMS (4)
 #endif
 
+/**
+ * largest payload sched_add_task_ctx copies into a task (in bytes, max 255), the
+ * payload shares the task's argument words so up to SCHED_MAX_TASK_PARAMS * 4
+ * bytes costs no extra memory
+ */
+#ifndef SCHED_CTX_SIZE
+#define SCHED_CTX_SIZE (16)
+#endif
+
+/**
+ * number of ready queue priority levels (max 32), tasks with a priority at or
+ * above the top level are treated as the top level
+ */
+#ifndef SCHED_PRIORITIES
+#define SCHED_PRIORITIES (32)
+#endif
+
+/**
+ * number of tasks that can be posted from isrs between runs of sched_run_tasks
+ * (must be a power of 2), see sched_post_from_isr
+ */
+#ifndef SCHED_POST_SIZE
+#define SCHED_POST_SIZE (16)
+#endif
+
+/**
+ * placement of the static task pool and the ready and post queues (ie the hal
+ * can put them in faster memory), the default is the normal bss
+ */
+#ifndef SCHED_MEM
+#define SCHED_MEM
+#endif
+
+/**
+ * clock used for task times, the default is the 1ms sys tick but any free
+ * running 32bit count will do, ie define SCHED_CLOCK as a function that
+ * returns hrtimer_get_us to schedule tasks in us (all the times passed to and
+ * returned from the scheduler are then in us, so sys_idle_until does not apply)
+ */
+#ifndef SCHED_CLOCK
+#define SCHED_CLOCK sys_get_tick
+#endif
+uint32_t SCHED_CLOCK(void);
+
+/**
+ * set SCHED_PROFILE to 1 to record task run times (in sys_get_cycles), start
+ * lateness (in SCHED_CLOCK ticks), the queue high water mark and allocation
+ * failures, see sched_get_profile (it costs nothing when 0)
+ */
+#ifndef SCHED_PROFILE
+#define SCHED_PROFILE (0)
+#endif
+
+#ifndef SCHED_PROFILE_CBS
+#define SCHED_PROFILE_CBS (16)		// number of callbacks profiled separately
+#endif
+#define SCHED_PROFILE_BUCKETS (16)	// lateness histogram buckets
+
+/**
+ * set SCHED_EVENTS to 1 for the event flags and message queues tasks can wait on
+ * (see sched_event.h), it costs two pointers per task
+ */
+#ifndef SCHED_EVENTS
+#define SCHED_EVENTS (0)
+#endif
+
+/**
+ * set SCHED_SLACK to 1 for the tasks that can run any time in a window (see
+ * sched_add_task_slack), it costs a word and a pointer per task
+ */
+#ifndef SCHED_SLACK
+#define SCHED_SLACK (0)
+#endif
+
+/**
+ * time queue backends, select one at compile time with SCHED_BACKEND
+ *  - SCHED_BACKEND_LIST: time sorted link list, O(n) add, smallest code (good for a handful of tasks)
+ *  - SCHED_BACKEND_HEAP: binary min heap on (time, priority), O(log n) add/remove
+ *  - SCHED_BACKEND_WHEEL: hierarchical timing wheel, O(1) add/remove (good for lots of timeouts)
+ */
+#define SCHED_BACKEND_LIST (0)
+#define SCHED_BACKEND_HEAP (1)
+#define SCHED_BACKEND_WHEEL (2)
+
+#ifndef SCHED_BACKEND
+#define SCHED_BACKEND SCHED_BACKEND_LIST
+#endif
+
+/**
+ * dispatch policy for late tasks, select one at compile time with SCHED_POLICY
+ *  - SCHED_POLICY_PRIORITY: highest priority first, oldest first for equal priorities
+ *  - SCHED_POLICY_EDF: earliest deadline first, the deadline of a task is its time plus
+ *    its relative deadline (see sched_set_deadline), priorities are ignored
+ */
+#define SCHED_POLICY_PRIORITY (0)
+#define SCHED_POLICY_EDF (1)
+
+#ifndef SCHED_POLICY
+#define SCHED_POLICY SCHED_POLICY_PRIORITY
+#endif
+
+/**
+ * rate of SCHED_CLOCK in Hz (used to convert run times in cycles to ticks, see sched_edf_admit)
+ */
+#ifndef SCHED_CLOCK_HZ
+#define SCHED_CLOCK_HZ (1000)
+#endif
+
+/**
+ * @brief handle for a queued task, it encodes the task slot and a generation
+ * count so it can be found in O(1) and goes stale once the task has run or been
+ * removed (a stale id is safely ignored)
+ */
 typedef uint32_t task_id_t;
 
 /**
  * @brief add a task to the task queue to run at a certain time with a certain priority
- * @param time the time (according to sys_get_tick) when this task should be run
- * @param priority run late tasks in the order of this priority
+ * @param time the time (according to SCHED_CLOCK, sys_get_tick by default) when this task should be run
+ * @param priority run late tasks in the order of this priority (highest first, oldest first for equal
+ * priorities), priorities of SCHED_PRIORITIES and above all run at the top level (not used by
+ * SCHED_POLICY_EDF)
  * @param callback run this callback when the task runs
  * @param argc number of arguments following this, these arguments are passed to the callback
+ * @return the id of the new task or -1 if it could not be added
  */
 task_id_t sched_add_task(uint32_t time, uint8_t priority, void *callback, uint8_t argc, ...);
 
+#if SCHED_SLACK
+/**
+ * @brief add a task that can run any time in a window, so it can share a wakeup with other tasks
+ * @param time the start of the window (according to SCHED_CLOCK)
+ * @param slack length of the window in ticks, the task runs by time + slack at the latest
+ * @param priority see sched_add_task
+ * @param callback run this callback when the task runs
+ * @param argc number of arguments following this, these arguments are passed to the callback
+ * @return the id of the new task or -1 if it could not be added
+ * @note sched_next_deadline reports the earliest window end so tasks whose windows overlap
+ * are run together at one wakeup, and a slack task whose window has started runs at any
+ * wakeup for another task (see sched_get_saved_wakeups)
+ */
+task_id_t sched_add_task_slack(uint32_t time, uint32_t slack, uint8_t priority, void *callback, uint8_t argc, ...);
+
+/**
+ * @brief get the number of wakeups saved by slack, ie slack tasks that ran along with another task
+ */
+uint32_t sched_get_saved_wakeups(void);
+#endif
+
+/**
+ * @brief callback of a task added with sched_add_task_ctx
+ * @param ctx the copy of the payload (4 byte aligned, only valid until the callback returns)
+ * @param len length of the payload in bytes
+ */
+typedef void (*sched_ctx_cb_t)(void *ctx, size_t len);
+
+/**
+ * @brief add a task that is passed a copy of a payload instead of arguments
+ * @param time see sched_add_task
+ * @param priority see sched_add_task
+ * @param callback run as callback(ctx, len) when the task runs, ctx points to the copy of the payload
+ * @param payload data to copy into the task (it need not be kept once this returns)
+ * @param len length of the payload in bytes (at most SCHED_CTX_SIZE)
+ * @return the id of the new task or -1 if it could not be added (ie the payload is too big)
+ * @note the payload is stored in the task slot so nothing is allocated for it
+ */
+task_id_t sched_add_task_ctx(uint32_t time, uint8_t priority, sched_ctx_cb_t callback, const void *payload, size_t len);
+
+/**
+ * @brief add a task that runs every period ticks until it is removed
+ * @param period number of ticks between releases of the task (must be > 0)
+ * @param phase number of ticks from now until the first release
+ * @param priority see sched_add_task
+ * @param callback run this callback each time the task runs
+ * @param argc number of arguments following this, these arguments are passed to the callback
+ * @return the id of the task (the same id is kept for every period) or -1 if it could not be added
+ * @note the task is re-queued from its ideal release time (not the time it actually ran) so it
+ * does not drift, no task is allocated or freed after the first add. If a release is missed
+ * completely the task skips ahead to its next release and the skipped periods are counted
+ * (see sched_get_overruns)
+ */
+task_id_t sched_add_periodic(uint32_t period, uint32_t phase, uint8_t priority, void *callback, uint8_t argc, ...);
+
+/**
+ * @brief get the number of periods a periodic task has skipped because it ran late
+ * @param task the id returned from sched_add_periodic
+ * @return the number of skipped periods, or -1 if the task is not queued
+ */
+int sched_get_overruns(task_id_t task);
+
+/**
+ * @brief remove all the periodic tasks that use a callback
+ * @param callback remove periodic tasks that run this callback (NULL for all periodic tasks)
+ * @return the number of tasks removed
+ */
+int sched_rm_periodic(void *callback);
+
+/**
+ * @brief add a task from an isr without disabling interrupts
+ * @param time the time (according to SCHED_CLOCK) when this task should be run
+ * @param priority see sched_add_task
+ * @param callback run this callback when the task runs
+ * @param argc number of arguments following this, these arguments are passed to the callback
+ * @return 1 if the task was posted, else 0 (ie the post ring is full or the arguments are invalid)
+ * @note the task is written to a lock free ring (ldrex/strex) and moved into the task queue by the
+ * next sched_run_tasks, so no task id is returned and it cannot be removed with sched_rm_task. This
+ * is safe from any isr priority and from nested isrs
+ */
+int sched_post_from_isr(uint32_t time, uint8_t priority, void *callback, uint8_t argc, ...);
+
 /**
  * @brief remove the specified task from the task list if it exists
  * @param task this is the task returned from sched_add_task that should be removed from the call list
- * @return if the task was found and removed return 0, else return 1
+ * @return if the task was found and removed return 1, else return 0 (ie the task already ran, was removed or the id is invalid)
  */
 int sched_rm_task(task_id_t task);
 
@@ -52,6 +252,172 @@ int sched_rm_task(task_id_t task);
  */
 int sched_run_tasks(int empty);
 
+/**
+ * @brief run the late tasks in priority order until a time budget is used up
+ * @param budget_us time budget in us (measured with the sys cycle counter, so it is capped
+ * at 2^31 cycles, about 12s at 168MHz)
+ * @return the number of tasks run (including the coroutines)
+ * @note all the tasks that are late when this is called are detached from the queue in one
+ * critical section and then run one at a time (after any woken coroutines), at least one task
+ * is run even if the budget is 0 (or the coroutines used it up). Once the budget is used up the remaining tasks are put back and run by the next call,
+ * tasks that become late while running wait for the next call too. The budget is only checked
+ * between tasks, so a long task can still overrun it
+ */
+int sched_run_for(uint32_t budget_us);
+
+/**
+ * @brief get the time the next task is due, so the cpu can idle until then (see sys_idle_until)
+ * @param tick set to the time (according to SCHED_CLOCK) of the next task, this is now if
+ * tasks are already late or have been posted from an isr
+ * @return 1 if there are tasks queued (or threads sleeping), else 0 (tick is not set)
+ * @note to avoid sleeping through a task posted by an isr call this and sys_idle_until from
+ * the same critical section (a pending interrupt still wakes the cpu). With SCHED_THREADS
+ * the wake tick of the first sleeping thread counts as a deadline too (thread sleeps are in
+ * sys ticks, so this assumes SCHED_CLOCK is left as sys_get_tick)
+ */
+int sched_next_deadline(uint32_t *tick);
+
+#if SCHED_POLICY == SCHED_POLICY_EDF
+/**
+ * @brief set the relative deadline of a task (used by SCHED_POLICY_EDF)
+ * @param task the id of a queued task
+ * @param deadline number of ticks after the task's time that it must have run by
+ * @return 1 if the deadline was set, else 0 (ie the task is not queued)
+ * @note a task without a deadline has a deadline of 0, ie it is due at its time, a
+ * periodic task's deadline starts as its period. Each release of a periodic task
+ * keeps the same relative deadline
+ */
+int sched_set_deadline(task_id_t task, uint32_t deadline);
+
+/**
+ * @brief a periodic task for sched_edf_admit
+ */
+struct sched_edf_task_t
+{
+	void *cb;						/**< the task callback */
+	uint32_t period;				/**< release period in ticks */
+	uint32_t deadline;				/**< relative deadline in ticks (0 for the period) */
+	uint32_t cycles;				/**< worst case run time in cycles (0 to use the longest run measured by the profile) */
+};
+
+/**
+ * @brief check a set of periodic tasks can meet their deadlines under SCHED_POLICY_EDF
+ * @param tasks the task set
+ * @param n number of tasks
+ * @param load set to the cpu load the set needs in 1/1000ths (the sum of run time / min(deadline, period))
+ * @return 1 if the load is at most 1000 (every deadline is met), 0 if it is too high or a run
+ * time is unknown
+ * @note this is the density test, it is exact when the deadlines are the periods and safe
+ * (it may reject sets that would fit) when they are shorter. Run times taken from the profile
+ * are only as good as the runs measured so far, so leave some headroom
+ */
+int sched_edf_admit(const struct sched_edf_task_t *tasks, int n, uint32_t *load);
+#endif
+
+#if SCHED_PROFILE
+
+/**
+ * @brief run time profile of a task callback
+ */
+struct sched_cb_profile_t
+{
+	void *cb;						/**< the callback (NULL for callbacks that did not fit in the table) */
+	uint32_t runs;					/**< number of times it ran */
+	uint32_t cycles_max;			/**< longest run in cycles */
+	uint64_t cycles_total;			/**< total cycles run (divide by runs for the average) */
+};
+
+/**
+ * @brief scheduler profile
+ */
+struct sched_profile_t
+{
+	uint32_t runs;								/**< number of tasks run */
+	uint32_t late[SCHED_PROFILE_BUCKETS];		/**< histogram of how late tasks started, bucket 0 is on time and bucket n
+												is 2^(n-1) to 2^n - 1 ticks late (the last bucket holds anything later) */
+	uint32_t late_max;							/**< latest start in ticks */
+	uint32_t used;								/**< number of tasks queued now (from sched_get_pool_stats) */
+	uint32_t used_max;							/**< high water mark of used (from sched_get_pool_stats) */
+	uint32_t alloc_failures;					/**< number of tasks that could not be queued as the pool was empty
+												(the pool stats failures) */
+};
+
+/**
+ * @brief get the scheduler profile
+ * @param profile filled in with a copy of the profile
+ */
+void sched_get_profile(struct sched_profile_t *profile);
+
+/**
+ * @brief get the run time profile of a callback
+ * @param n index of the callback (0 to SCHED_PROFILE_CBS, the last is the catch all for a full table)
+ * @param cb filled in with a copy of the callback profile
+ * @return 1 if the callback profile at n has been used, else 0
+ */
+int sched_get_cb_profile(int n, struct sched_cb_profile_t *cb);
+
+/**
+ * @brief clear the profile (the task counts come from the pool stats, which are only cleared by sched_init)
+ */
+void sched_profile_reset(void);
+
+/**
+ * @brief write the profile as text
+ * @param buf buffer to write to (it is always null terminated)
+ * @param len size of buf
+ * @return number of characters written
+ */
+int sched_profile_format(char *buf, int len);
+
+/**
+ * @brief write the profile as text to a uart (see sched_profile_format)
+ * @param uart uart to write to
+ * @return 1 if the write started, 0 if the last dump is still being written or the
+ * uart refused the write (ie it is busy with another writer)
+ */
+struct uart_t;
+int sched_profile_dump(struct uart_t *uart);
+
+#endif
+
+/**
+ * @brief task pool usage
+ */
+struct sched_pool_stats_t
+{
+	uint32_t size;					/**< number of tasks in the pool */
+	uint32_t used;					/**< number of tasks queued now */
+	uint32_t used_max;				/**< high water mark of used */
+	uint32_t failures;				/**< number of tasks that could not be queued as the pool was empty */
+};
+
+/**
+ * @brief get the task pool usage
+ * @param stats filled in with a copy of the stats
+ */
+void sched_get_pool_stats(struct sched_pool_stats_t *stats);
+
+/**
+ * @brief called when a task can't be queued because every task in the pool is in use
+ * @param callback the callback of the task that was not queued
+ * @note this is a weak function that does nothing, define it to log or recover (ie
+ * remove less important tasks). It is called with the scheduler locked, possibly from
+ * an isr, so keep it short and don't add tasks from it
+ */
+void sched_pool_exhausted(void *callback);
+
+/**
+ * @brief init this module with a task pool in mem instead of the static pool of SCHED_MAX_TASKS
+ * @param mem memory for the pool (ie in ccm or external sdram once fmc_sdram_init has run), NULL
+ * to go back to the static pool
+ * @param bytes size of mem, the pool holds as many tasks as fit
+ * @return the number of tasks in the pool (0 if mem is too small, the static pool is kept)
+ * @note call this instead of sched_init (later calls to sched_init keep this pool), set
+ * SCHED_MAX_TASKS to 1 to save the memory of the unused static pool. Task ids hold 16 slot
+ * bits so the pool is limited to 65535 tasks
+ */
+int sched_init_pool(void *mem, size_t bytes);
+
 /**
  * @brief init this module
  */
@@ -0,0 +1,159 @@
+/**
+ * @file sched_co.c
+ *
+ * @brief implement the coroutine queue of the mos scheduler
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#define SYS_LOCK_MODULE SYS_LOCK_SCHED
+
+#include <hal.h>
+#include "sched.h"
+#include "sched_co.h"
+
+// coroutines waiting to be resumed in the order they were woken
+static co_t *queue_head = NULL, *queue_tail = NULL;
+
+
+void co_wake(co_t *co)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	// a coroutine is only queued once however many times it is woken
+	if (!co->queued)
+	{
+		co->queued = 1;
+		co->next = NULL;
+		if (queue_tail)
+			queue_tail->next = co;
+		else
+			queue_head = co;
+		queue_tail = co;
+	}
+
+	sys_unlock(lock);
+}
+
+
+void co_start(co_t *co, co_fn_t fn, void *param)
+{
+	co->fn = fn;
+	co->param = param;
+	co->line = 0;
+	co->result = 0;
+	co_wake(co);
+}
+
+
+// task args are 32bit so the co pointer is passed in two halves (the high half
+// is always 0 on the target, it is only needed for 64bit host builds)
+static void co_delay_done(uint32_t lo, uint32_t hi)
+{
+	co_t *co = (co_t *)(uintptr_t)(((uint64_t)hi << 32) | lo);
+
+	co->result = 0;
+	co_wake(co);
+}
+
+
+void co_delay(co_t *co, uint32_t ms)
+{
+	uint64_t p = (uintptr_t)co;
+
+	if (sched_add_task(SCHED_CLOCK() + ms, SCHED_CO_PRIORITY, co_delay_done, 2, (uint32_t)p, (uint32_t)(p >> 32)) == -1)
+	{
+		// no task free for the timer so carry on straight away and flag it
+		co->result = -1;
+		co_wake(co);
+	}
+}
+
+
+#ifdef __UART__
+void co_uart_done(uart_t *uart, void *buf, uint16_t len, void *param)
+{
+	co_t *co = (co_t *)param;
+
+	co->result = len;
+	co_wake(co);
+}
+
+
+void co_uart_read(co_t *co, uart_t *uart, void *buf, uint16_t len)
+{
+	if (uart_read(uart, buf, len, co_uart_done, co) != 0)
+	{
+		// co_uart_done won't come so carry on straight away and flag it
+		co->result = -1;
+		co_wake(co);
+	}
+}
+
+
+void co_uart_write(co_t *co, uart_t *uart, void *buf, uint16_t len)
+{
+	if (uart_write(uart, buf, len, co_uart_done, co) != 0)
+	{
+		co->result = -1;
+		co_wake(co);
+	}
+}
+#endif
+
+
+#ifdef __SPIM__
+void co_spim_done(spim_t *spim, uint16_t addr, void *read_buf, void *write_buf, uint16_t len, void *param)
+{
+	co_t *co = (co_t *)param;
+
+	co->result = len;
+	co_wake(co);
+}
+#endif
+
+
+int co_run_queued(int max)
+{
+	co_t *co, *last;
+	int n = 0;
+	sys_lock_t lock;
+
+	// only resume the coroutines queued now so a coroutine that yields can't
+	// keep sched_run_tasks here forever
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	last = queue_tail;
+	sys_unlock(lock);
+
+	while (last && (max == 0 || n < max))
+	{
+		lock = sys_lock(SYS_LOCK_KERNEL);
+		co = queue_head;
+		queue_head = co->next;
+		if (queue_head == NULL)
+			queue_tail = NULL;
+		co->next = NULL;
+		co->queued = 0;
+		sys_unlock(lock);
+
+		co->fn(co);
+		n++;
+
+		if (co == last)
+			break;
+	}
+
+	return n;
+}
+
+
+int co_queued(void)
+{
+	return queue_head != NULL;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file sched_co.h
+ *
+ * @brief stackless coroutines (protothreads) run by the mos scheduler
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note a coroutine is a function that can wait part way through for a driver
+ * or a delay and carry on from the same place once it completes, so a chain
+ * of driver callbacks can be written as straight line code, ie
+ *
+ *	struct sensor_t { co_t co; uint8_t buf[8]; int retries; };
+ *
+ *	int sensor_co(co_t *co)
+ *	{
+ *		struct sensor_t *s = (struct sensor_t *)co;
+ *
+ *		CO_BEGIN(co);
+ *		while (1)
+ *		{
+ *			AWAIT_SPIM_XFER(co, &spim_dev, &opts, 0, s->buf, s->buf, 8);
+ *			AWAIT_DELAY(co, 10);
+ *		}
+ *		CO_END(co);
+ *	}
+ *
+ *	co_start(&sensor.co, sensor_co, NULL);
+ *
+ * There is no stack per coroutine so local variables are lost at every
+ * AWAIT, keep anything that has to survive in a struct that embeds the co_t
+ * (as above). Don't use switch statements around an AWAIT (the resume point
+ * is a case label). The driver completion callbacks just queue the coroutine
+ * (no task is allocated), sched_run_tasks resumes the queued coroutines
+ * before it runs any tasks. Include hal.h before this file.
+ *
+ */
+
+#include <stdint.h>
+#include "sched.h"
+
+#ifndef __SCHED_CO__
+#define __SCHED_CO__
+
+/**
+ * priority of the task that wakes a coroutine at the end of AWAIT_DELAY
+ */
+#ifndef SCHED_CO_PRIORITY
+#define SCHED_CO_PRIORITY (SCHED_PRIORITIES - 1)
+#endif
+
+#define CO_WAITING (0)		// the coroutine is waiting for an AWAIT to complete
+#define CO_DONE (1)			// the coroutine has reached CO_END
+
+/**
+ * @brief coroutine state
+ */
+typedef struct co_t co_t;
+typedef int (*co_fn_t)(co_t *co);
+struct co_t
+{
+	co_fn_t fn;				// coroutine function, returns CO_WAITING or CO_DONE
+	void *param;			// user parameter
+	uint16_t line;			// where to resume (0 is the start)
+	uint8_t queued;			// queued to be resumed
+	int result;				// result of the last AWAIT (bytes transferred or -1 on error)
+	co_t *next;				// resume queue
+};
+
+
+/**
+ * @brief start the coroutine body (the first statement in a coroutine function)
+ */
+#define CO_BEGIN(co) switch ((co)->line) { case 0:
+
+
+/**
+ * @brief end the coroutine body (the last statement in a coroutine function)
+ */
+#define CO_END(co) } (co)->line = 0; return CO_DONE
+
+
+/**
+ * @brief start something that completes later and wait for it, start must
+ * arrange for co_wake to be called on completion (ie from a driver callback)
+ */
+#define CO_AWAIT(co, start) \
+	do \
+	{ \
+		(co)->line = __LINE__; \
+		start; \
+		return CO_WAITING; \
+		case __LINE__:; \
+	} while (0)
+
+
+/**
+ * @brief let the other coroutines and tasks run and then carry on
+ */
+#define CO_YIELD(co) CO_AWAIT(co, co_wake(co))
+
+
+/**
+ * @brief wait for ms (SCHED_CLOCK ticks)
+ */
+#define AWAIT_DELAY(co, ms) CO_AWAIT(co, co_delay(co, ms))
+
+
+// the driver adapters are only there if the hal has the driver (include hal.h first)
+#ifdef __UART__
+/**
+ * @brief start a uart read and wait for it to complete (see uart_read), the
+ * number of bytes read is left in co->result (-1 if the uart refused the read)
+ */
+#define AWAIT_UART_READ(co, uart, buf, len) CO_AWAIT(co, co_uart_read(co, uart, buf, len))
+
+
+/**
+ * @brief start a uart write and wait for it to complete (see uart_write), the
+ * number of bytes written is left in co->result (-1 if the uart refused the write)
+ */
+#define AWAIT_UART_WRITE(co, uart, buf, len) CO_AWAIT(co, co_uart_write(co, uart, buf, len))
+#endif
+
+
+#ifdef __SPIM__
+/**
+ * @brief start a spi master transfer and wait for it to complete (see spim_xfer),
+ * the number of bytes transferred is left in co->result
+ */
+#define AWAIT_SPIM_XFER(co, spim, opts, addr, read_buf, write_buf, len) \
+	CO_AWAIT(co, spim_xfer(spim, opts, addr, read_buf, write_buf, len, co_spim_done, co))
+#endif
+
+
+/**
+ * @brief start a coroutine from the beginning
+ * @param co coroutine state
+ * @param fn coroutine function
+ * @param param user parameter (co->param)
+ * @note the coroutine is queued to run by the next sched_run_tasks
+ */
+void co_start(co_t *co, co_fn_t fn, void *param);
+
+
+/**
+ * @brief queue a waiting coroutine to be resumed (safe from isrs, it does not allocate)
+ * @param co coroutine to resume
+ */
+void co_wake(co_t *co);
+
+
+/**
+ * @brief wake a coroutine after a delay (see AWAIT_DELAY)
+ * @param co coroutine to wake
+ * @param ms delay in SCHED_CLOCK ticks
+ */
+void co_delay(co_t *co, uint32_t ms);
+
+
+#ifdef __UART__
+/**
+ * @brief start a uart read or write that wakes co when it completes (see
+ * AWAIT_UART_READ/AWAIT_UART_WRITE), co is woken straight away with -1 if the
+ * uart refuses it (ie it is busy)
+ */
+void co_uart_read(co_t *co, uart_t *uart, void *buf, uint16_t len);
+void co_uart_write(co_t *co, uart_t *uart, void *buf, uint16_t len);
+#endif
+
+
+/**
+ * @brief driver completion callbacks that wake the coroutine passed as param
+ */
+#ifdef __UART__
+void co_uart_done(uart_t *uart, void *buf, uint16_t len, void *param);
+#endif
+#ifdef __SPIM__
+void co_spim_done(spim_t *spim, uint16_t addr, void *read_buf, void *write_buf, uint16_t len, void *param);
+#endif
+
+
+/**
+ * @brief resume the queued coroutines (used by sched_run_tasks)
+ * @param max resume at most this many coroutines (0 for all those queued now)
+ * @return number of coroutines resumed
+ */
+int co_run_queued(int max);
+
+
+/**
+ * @brief are any coroutines queued (used by sched_next_deadline)
+ * @return 1 if coroutines are queued, else 0
+ */
+int co_queued(void);
+
+#endif
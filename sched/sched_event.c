@@ -0,0 +1,182 @@
+/**
+ * @file sched_event.c
+ *
+ * @brief implement the event flags and message queues of the mos scheduler
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#define SYS_LOCK_MODULE SYS_LOCK_SCHED
+
+#include <string.h>
+#include <hal.h>
+#include "sched.h"
+#include "sched_event.h"
+#include "sched_wait.h"
+
+#if SCHED_EVENTS
+
+
+void sched_event_init(sched_event_t *event)
+{
+	event->flags = 0;
+	event->waiters = NULL;
+}
+
+
+task_id_t sched_wait_event(sched_event_t *event, uint32_t mask, uint32_t timeout, uint8_t priority, void *callback, uint32_t arg)
+{
+	struct task_info_t *t;
+	task_id_t ret = -1;
+	sys_lock_t lock;
+
+	if (callback == NULL || mask == 0)
+		return -1;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	t = wait_add(&event->waiters, timeout, priority, callback, arg, mask);
+	if (!t)
+		goto done;
+	ret = t->task_id;
+
+	// flags that are already set wake it straight away
+	if (event->flags & mask)
+	{
+		wait_wake(t, event->flags & mask);
+		event->flags &= ~mask;
+	}
+
+done:
+	sys_unlock(lock);
+	return ret;
+}
+
+
+void sched_set_event(sched_event_t *event, uint32_t flags)
+{
+	struct task_info_t *t, *next;
+	uint32_t woken = 0;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	event->flags |= flags;
+
+	// every waiter gets the flags, they are cleared once the waiters have them
+	for (t = event->waiters; t; t = next)
+	{
+		uint32_t mask = t->argv[1];
+
+		next = t->wait_next;
+		if (event->flags & mask)
+		{
+			woken |= event->flags & mask;
+			wait_wake(t, event->flags & mask);
+		}
+	}
+	event->flags &= ~woken;
+
+	sys_unlock(lock);
+}
+
+
+void sched_clear_event(sched_event_t *event, uint32_t flags)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	event->flags &= ~flags;
+	sys_unlock(lock);
+}
+
+
+void sched_queue_init(sched_queue_t *queue, void *buf, uint16_t item_size, uint16_t len)
+{
+	queue->buf = buf;
+	queue->item_size = item_size;
+	queue->len = len;
+	queue->head = 0;
+	queue->count = 0;
+	queue->waiters = NULL;
+}
+
+
+int sched_queue_send(sched_queue_t *queue, const void *item)
+{
+	uint16_t k;
+	int ret = 0;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	if (queue->count == queue->len)
+		goto done;
+
+	k = queue->head + queue->count;
+	if (k >= queue->len)
+		k -= queue->len;
+	memcpy(&queue->buf[k * queue->item_size], item, queue->item_size);
+	queue->count++;
+	ret = 1;
+
+	if (queue->waiters)
+		wait_wake(queue->waiters, queue->count);
+
+done:
+	sys_unlock(lock);
+	return ret;
+}
+
+
+int sched_queue_receive(sched_queue_t *queue, void *item)
+{
+	int ret = 0;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	if (queue->count == 0)
+		goto done;
+
+	memcpy(item, &queue->buf[queue->head * queue->item_size], queue->item_size);
+	if (++queue->head == queue->len)
+		queue->head = 0;
+	queue->count--;
+	ret = 1;
+
+done:
+	sys_unlock(lock);
+	return ret;
+}
+
+
+task_id_t sched_wait_queue(sched_queue_t *queue, uint32_t timeout, uint8_t priority, void *callback, uint32_t arg)
+{
+	struct task_info_t *t;
+	task_id_t ret = -1;
+	sys_lock_t lock;
+
+	if (callback == NULL)
+		return -1;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	t = wait_add(&queue->waiters, timeout, priority, callback, arg, 0);
+	if (!t)
+		goto done;
+	ret = t->task_id;
+
+	if (queue->count)
+		wait_wake(t, queue->count);
+
+done:
+	sys_unlock(lock);
+	return ret;
+}
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * @file sched_event.h
+ *
+ * @brief event flags and message queues that wake scheduler tasks
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note a task can wait on an event (a set of flags) or a queue instead of a
+ * time, it is made ready as soon as a flag it waits for is set or an item is
+ * sent (from a task or an isr) so consumers don't have to poll, ie
+ *
+ *	static sched_event_t usb_event;
+ *
+ *	void usb_received(void) { sched_set_event(&usb_event, 1); }	// usb_config_t received_cb
+ *
+ *	void usb_reader(uint32_t arg, uint32_t flags)
+ *	{
+ *		if (flags)
+ *			usb_hid_read(usb, id, buf, len);
+ *		sched_wait_event(&usb_event, 1, 0, 5, usb_reader, 0);
+ *	}
+ *
+ * A waiting task runs once (like a task from sched_add_task), wait again
+ * from the callback to keep receiving. The callback is run as
+ * callback(arg, value) where value is 0 if the wait timed out. Include hal.h
+ * before this file and set SCHED_EVENTS to 1.
+ *
+ */
+
+#include <stdint.h>
+#include "sched.h"
+
+#ifndef __SCHED_EVENT__
+#define __SCHED_EVENT__
+
+#if SCHED_EVENTS
+
+struct task_info_t;
+
+/**
+ * @brief a set of 32 event flags
+ */
+typedef struct
+{
+	volatile uint32_t flags;
+	struct task_info_t *waiters;
+} sched_event_t;
+
+/**
+ * @brief a queue of fixed size items
+ */
+typedef struct
+{
+	uint8_t *buf;
+	uint16_t item_size;
+	uint16_t len;					// number of items buf holds
+	volatile uint16_t head;			// next item to receive
+	volatile uint16_t count;		// number of items queued
+	struct task_info_t *waiters;
+} sched_queue_t;
+
+
+/**
+ * @brief init an event with no flags set
+ */
+void sched_event_init(sched_event_t *event);
+
+
+/**
+ * @brief run a task once any of the flags in mask are set
+ * @param event event to wait on
+ * @param mask flags to wait for
+ * @param timeout run the task anyway after this many SCHED_CLOCK ticks (0 to wait forever)
+ * @param priority see sched_add_task
+ * @param callback run as callback(arg, flags) with the flags in mask that were set (0 on a timeout)
+ * @param arg first callback argument
+ * @return the id of the task (it can be removed with sched_rm_task) or -1 if it could not be added
+ * @note the flags that wake a task are cleared, if they are set already the task is ready straight away
+ */
+task_id_t sched_wait_event(sched_event_t *event, uint32_t mask, uint32_t timeout, uint8_t priority, void *callback, uint32_t arg);
+
+
+/**
+ * @brief set event flags, waking the tasks waiting for any of them (safe from isrs)
+ * @param event event to set
+ * @param flags flags to set
+ * @note flags that no task is waiting for stay set until a task waits for them or they are cleared
+ */
+void sched_set_event(sched_event_t *event, uint32_t flags);
+
+
+/**
+ * @brief clear event flags
+ * @param event event to clear
+ * @param flags flags to clear
+ */
+void sched_clear_event(sched_event_t *event, uint32_t flags);
+
+
+/**
+ * @brief init an empty queue
+ * @param queue queue to init
+ * @param buf memory for len items of item_size bytes
+ * @param item_size size of an item in bytes
+ * @param len number of items buf holds
+ */
+void sched_queue_init(sched_queue_t *queue, void *buf, uint16_t item_size, uint16_t len);
+
+
+/**
+ * @brief copy an item on to the end of a queue, waking the first task waiting on it (safe from isrs)
+ * @param queue queue to send to
+ * @param item item_size bytes to copy
+ * @return 1 if the item was queued, 0 if the queue is full
+ */
+int sched_queue_send(sched_queue_t *queue, const void *item);
+#define sched_queue_send_from_isr sched_queue_send
+
+
+/**
+ * @brief copy the first item off a queue
+ * @param queue queue to receive from
+ * @param item set to the item
+ * @return 1 if an item was received, 0 if the queue is empty
+ */
+int sched_queue_receive(sched_queue_t *queue, void *item);
+
+
+/**
+ * @brief run a task once the queue has an item
+ * @param queue queue to wait on
+ * @param timeout run the task anyway after this many SCHED_CLOCK ticks (0 to wait forever)
+ * @param priority see sched_add_task
+ * @param callback run as callback(arg, count) with the number of items queued (0 on a timeout),
+ * use sched_queue_receive to take them
+ * @param arg first callback argument
+ * @return the id of the task (it can be removed with sched_rm_task) or -1 if it could not be added
+ * @note each item sent wakes one waiting task (the first to wait), if items are queued already
+ * the task is ready straight away
+ */
+task_id_t sched_wait_queue(sched_queue_t *queue, uint32_t timeout, uint8_t priority, void *callback, uint32_t arg);
+
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * @file sched_heap.c
+ *
+ * @brief binary min heap backend for the mos scheduler
+ *
+ * tasks are kept in a heap ordered by (time, priority) so insert and remove
+ * are O(log n) and the next late task is always the top of the heap (see
+ * SCHED_BACKEND)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+#include "sched_tq.h"
+
+#if SCHED_BACKEND == SCHED_BACKEND_HEAP
+
+static struct task_info_t *heap_static[SCHED_MAX_TASKS] SCHED_MEM;
+static struct task_info_t **heap = heap_static;
+static int heap_len = 0;
+
+
+void tq_init(void *mem, uint32_t tasks)
+{
+	// the heap never holds more than the number of tasks so it needs no checks
+	heap = mem ? (struct task_info_t **)mem : heap_static;
+	heap_len = 0;
+}
+
+
+// does task a need to run before task b (earliest time first, then highest priority)
+static int before(struct task_info_t *a, struct task_info_t *b)
+{
+	int32_t dt = sys_tick_diff(a->time, b->time);
+
+	if (dt != 0)
+		return dt > 0;
+	return a->priority > b->priority;
+}
+
+
+static void heap_set(int idx, struct task_info_t *task)
+{
+	heap[idx] = task;
+	task->idx = idx;
+}
+
+
+// move the task at idx towards the root until the heap is ordered
+static void sift_up(int idx)
+{
+	struct task_info_t *task = heap[idx];
+
+	while (idx > 0)
+	{
+		int parent = (idx - 1) / 2;
+		if (!before(task, heap[parent]))
+			break;
+		heap_set(idx, heap[parent]);
+		idx = parent;
+	}
+	heap_set(idx, task);
+}
+
+
+// move the task at idx towards the leaves until the heap is ordered
+static void sift_down(int idx)
+{
+	struct task_info_t *task = heap[idx];
+
+	while (1)
+	{
+		int child = 2 * idx + 1;
+		if (child >= heap_len)
+			break;
+		if (child + 1 < heap_len && before(heap[child + 1], heap[child]))
+			// use the earlier of the two children
+			child++;
+		if (!before(heap[child], task))
+			break;
+		heap_set(idx, heap[child]);
+		idx = child;
+	}
+	heap_set(idx, task);
+}
+
+
+void tq_insert(struct task_info_t *task)
+{
+	heap_set(heap_len++, task);
+	sift_up(task->idx);
+}
+
+
+void tq_remove(struct task_info_t *task)
+{
+	int idx = task->idx;
+
+	// fill the hole with the last task in the heap and then restore
+	// the heap order (the last task may need to go either way)
+	heap_len--;
+	if (idx != heap_len)
+	{
+		struct task_info_t *last = heap[heap_len];
+		heap_set(idx, last);
+		sift_up(idx);
+		sift_down(last->idx);
+	}
+	heap[heap_len] = NULL;
+	task->idx = -1;
+}
+
+
+int tq_next_time(uint32_t *time)
+{
+	if (heap_len == 0)
+		return 0;
+	*time = heap[0]->time;
+	return 1;
+}
+
+
+struct task_info_t *tq_pop_late(uint32_t now)
+{
+	struct task_info_t *t;
+
+	// the top of the heap is the earliest task, if it is not late none are
+	if (heap_len == 0)
+		return NULL;
+	t = heap[0];
+	if (sys_tick_diff(now, t->time) > 0)
+		return NULL;
+
+	tq_remove(t);
+	return t;
+}
+
+#endif
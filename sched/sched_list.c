@@ -0,0 +1,100 @@
+/**
+ * @file sched_list.c
+ *
+ * @brief time sorted double link list backend for the mos scheduler
+ *
+ * this is the original scheduler backend, inserts are O(n) but it has
+ * next to no overhead for small task lists (see SCHED_BACKEND)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+#include "sched_tq.h"
+
+#if SCHED_BACKEND == SCHED_BACKEND_LIST
+
+static struct task_info_t *task_list_head = NULL;
+
+
+void tq_init(void *mem, uint32_t tasks)
+{
+	task_list_head = NULL;
+}
+
+
+// insert task between a and b
+static void insert_task(struct task_info_t *a, struct task_info_t *b, struct task_info_t *task)
+{
+	if (a)
+		a->next = task;
+	if (b)
+		b->prev = task;
+	task->prev = a;
+	task->next = b;
+	if (!task_list_head || b == task_list_head)
+		task_list_head = task;
+}
+
+
+void tq_insert(struct task_info_t *new_task)
+{
+	struct task_info_t *prev_task, *task;
+
+	// find where this task should go in the task
+	// link list (it is ordered by time where the
+	// first task is the next to run)
+	for (prev_task = NULL, task = task_list_head; task; prev_task = task, task = task->next)
+	{
+		if (sys_tick_diff(new_task->time, task->time) > 0)
+			// task runs later than the new_task so we want to prepend new_task
+			break;
+	}
+
+	// insert this task into the task_list (prev_task and/or task are NULL if
+	// the new task is the only, the first or the last task in the list)
+	insert_task(prev_task, task, new_task);
+}
+
+
+void tq_remove(struct task_info_t *t)
+{
+	struct task_info_t *prev = t->prev, *next = t->next;
+
+	if (prev)
+		prev->next = next;
+	if (next)
+		next->prev = prev;
+	if (t == task_list_head)
+		// if we are removing the head then we need to update it
+		task_list_head = next;
+	t->next = t->prev = NULL;
+}
+
+
+int tq_next_time(uint32_t *time)
+{
+	if (task_list_head == NULL)
+		return 0;
+	*time = task_list_head->time;
+	return 1;
+}
+
+
+struct task_info_t *tq_pop_late(uint32_t now)
+{
+	struct task_info_t *t = task_list_head;
+
+	// the task list is sorted by time so only the head can be the next late task
+	if (t == NULL || sys_tick_diff(now, t->time) > 0)
+		return NULL;
+
+	tq_remove(t);
+	return t;
+}
+
+#endif
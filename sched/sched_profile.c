@@ -0,0 +1,188 @@
+/**
+ * @file sched_profile.c
+ *
+ * @brief optional run time profile of the mos scheduler (see SCHED_PROFILE)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#define SYS_LOCK_MODULE SYS_LOCK_SCHED
+
+#include <stdio.h>
+#include <string.h>
+#include <hal.h>
+#include "sched.h"
+#include "sched_profile.h"
+
+#if SCHED_PROFILE
+
+static struct sched_profile_t profile;
+static struct sched_cb_profile_t cb_profile[SCHED_PROFILE_CBS + 1]; // the last is the catch all
+
+static char dump_buf[512];
+static volatile uint8_t dump_busy = 0;
+
+
+void profile_init(void)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	memset(&profile, 0, sizeof(profile));
+	memset(cb_profile, 0, sizeof(cb_profile));
+	sys_unlock(lock);
+}
+
+
+// find the profile for cb, adding it if it is new (a full table uses the catch all)
+static struct sched_cb_profile_t * find_cb(void *cb)
+{
+	int k;
+
+	for (k = 0; k < SCHED_PROFILE_CBS; k++)
+	{
+		if (cb_profile[k].cb == cb)
+			return &cb_profile[k];
+		if (cb_profile[k].cb == NULL)
+		{
+			cb_profile[k].cb = cb;
+			return &cb_profile[k];
+		}
+	}
+	return &cb_profile[SCHED_PROFILE_CBS];
+}
+
+
+void profile_run(void *cb, uint32_t late, uint32_t cycles)
+{
+	struct sched_cb_profile_t *p = find_cb(cb);
+	int bucket = late ? 32 - count_leading_zeros(late) : 0;
+
+	// runs are only recorded from the main loop so only the copy out needs protecting
+	if (bucket >= SCHED_PROFILE_BUCKETS)
+		bucket = SCHED_PROFILE_BUCKETS - 1;
+	profile.late[bucket]++;
+	if (late > profile.late_max)
+		profile.late_max = late;
+	profile.runs++;
+
+	p->runs++;
+	p->cycles_total += cycles;
+	if (cycles > p->cycles_max)
+		p->cycles_max = cycles;
+}
+
+
+void sched_get_profile(struct sched_profile_t *p)
+{
+	struct sched_pool_stats_t pool;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	*p = profile;
+	sys_unlock(lock);
+
+	// the pool keeps the task counts
+	sched_get_pool_stats(&pool);
+	p->used = pool.used;
+	p->used_max = pool.used_max;
+	p->alloc_failures = pool.failures;
+}
+
+
+int sched_get_cb_profile(int n, struct sched_cb_profile_t *cb)
+{
+	sys_lock_t lock;
+
+	if (n < 0 || n > SCHED_PROFILE_CBS)
+		return 0;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	*cb = cb_profile[n];
+	sys_unlock(lock);
+
+	return cb->runs != 0;
+}
+
+
+void sched_profile_reset(void)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	memset(&profile, 0, sizeof(profile));
+	memset(cb_profile, 0, sizeof(cb_profile));
+	sys_unlock(lock);
+}
+
+
+int sched_profile_format(char *buf, int len)
+{
+	struct sched_profile_t p;
+	struct sched_cb_profile_t cb;
+	int k, n = 0;
+
+	if (len <= 0)
+		return 0;
+	buf[0] = '\0';
+
+	// snprintf returns the length it wanted so stop adding once the buffer is full
+#define ADD(...) do { if (n < len) n += snprintf(buf + n, len - n, __VA_ARGS__); } while (0)
+
+	sched_get_profile(&p);
+	ADD("sched: runs %lu, tasks %lu (max %lu), alloc failures %lu\r\n",
+		(unsigned long)p.runs, (unsigned long)p.used, (unsigned long)p.used_max, (unsigned long)p.alloc_failures);
+
+	ADD("late (ticks):");
+	for (k = 0; k < SCHED_PROFILE_BUCKETS; k++)
+		if (p.late[k])
+		{
+			if (k == SCHED_PROFILE_BUCKETS - 1)
+				ADD(" >=%lu:%lu", 1ul << (k - 1), (unsigned long)p.late[k]);
+			else
+				ADD(" <%lu:%lu", 1ul << k, (unsigned long)p.late[k]);
+		}
+	ADD(", max %lu\r\n", (unsigned long)p.late_max);
+
+	for (k = 0; k <= SCHED_PROFILE_CBS; k++)
+		if (sched_get_cb_profile(k, &cb))
+			ADD("cb %p: runs %lu, cycles max %lu avg %lu\r\n", cb.cb, (unsigned long)cb.runs,
+				(unsigned long)cb.cycles_max, (unsigned long)(cb.cycles_total / cb.runs));
+
+#undef ADD
+
+	return n < len ? n : len - 1;
+}
+
+
+static void dump_done(uart_t *uart, void *buf, uint16_t len, void *param)
+{
+	dump_busy = 0;
+}
+
+
+int sched_profile_dump(uart_t *uart)
+{
+	int n;
+
+	// the uart writes from dump_buf in the background so wait for the last dump
+	if (dump_busy)
+		return 0;
+	dump_busy = 1;
+
+	n = sched_profile_format(dump_buf, sizeof(dump_buf));
+	if (uart_write(uart, dump_buf, n, dump_done, NULL) != 0)
+	{
+		// the uart is busy with another writer, dump_done won't come
+		dump_busy = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+#endif
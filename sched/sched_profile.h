@@ -0,0 +1,39 @@
+/**
+ * @file sched_profile.h
+ *
+ * @brief internal hooks sched.c uses to record the scheduler profile
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note this is not part of the public interface (see sched_get_profile), the
+ * hooks are only called when SCHED_PROFILE is set
+ *
+ */
+
+#include <stdint.h>
+#include "sched.h"
+
+#ifndef __SCHED_PROFILE__
+#define __SCHED_PROFILE__
+
+#if SCHED_PROFILE
+
+/**
+ * @brief clear the whole profile (on sched_init)
+ */
+void profile_init(void);
+
+
+/**
+ * @brief record a task run
+ * @param cb the task callback
+ * @param late number of ticks after its time that the task started
+ * @param cycles number of cycles the task ran for
+ */
+void profile_run(void *cb, uint32_t late, uint32_t cycles);
+
+#endif
+
+#endif
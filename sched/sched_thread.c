@@ -0,0 +1,462 @@
+/**
+ * @file sched_thread.c
+ *
+ * @brief implement the optional preemptive threads of the mos scheduler (see SCHED_THREADS)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#define SYS_LOCK_MODULE SYS_LOCK_SCHED
+
+#include <stddef.h>
+#include <hal.h>
+#include "sched_thread.h"
+#include "sched_thread_port.h"
+
+#if SCHED_THREADS
+
+/* ready threads are kept in a circular fifo per priority with a bit set in map
+ * for each priority that has a ready thread, as for the scheduler's ready
+ * tasks. The running thread stays at the head of its fifo so the thread to
+ * run is always the head of the highest fifo */
+struct thread_ready_t
+{
+	uint32_t map;
+	thread_t *head[THREAD_PRIORITY_MAX + 1];
+};
+static struct thread_ready_t ready;
+
+static thread_t *sleepers = NULL;	// sleeping threads in wake order
+static struct thread_stats_t stats;
+
+static thread_t main_thread;
+static thread_t idle_thread;
+static uint64_t idle_stack[SCHED_THREAD_IDLE_STACK / sizeof(uint64_t)];
+
+thread_t *thread_current = NULL;
+
+
+static void ready_insert(thread_t *t, int at_head)
+{
+	thread_t *head = ready.head[t->priority];
+
+	if (head == NULL)
+	{
+		t->next = t->prev = t;
+		ready.head[t->priority] = t;
+		ready.map |= 1 << t->priority;
+		return;
+	}
+	t->next = head;
+	t->prev = head->prev;
+	head->prev->next = t;
+	head->prev = t;
+	if (at_head)
+		ready.head[t->priority] = t;
+}
+
+
+static void ready_remove(thread_t *t)
+{
+	if (t->next == t)
+	{
+		ready.head[t->priority] = NULL;
+		ready.map &= ~(1 << t->priority);
+		return;
+	}
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	if (ready.head[t->priority] == t)
+		ready.head[t->priority] = t->next;
+}
+
+
+// the idle thread is always ready so there is always a top thread
+static thread_t * ready_top(void)
+{
+	return ready.head[31 - count_leading_zeros(ready.map)];
+}
+
+
+// switch if the running thread has stopped or a higher priority thread is ready
+static void reschedule(void)
+{
+	if (thread_current->state != THREAD_READY || ready_top() != thread_current)
+		port_switch();
+}
+
+
+static void make_ready(thread_t *t)
+{
+	t->state = THREAD_READY;
+	ready_insert(t, 0);
+}
+
+
+// change the priority of t, keeping it in the right place in the ready or mutex wait list
+static void set_priority(thread_t *t, uint8_t priority)
+{
+	mutex_t *m;
+	thread_t **p;
+
+	if (t->priority == priority)
+		return;
+
+	if (t->state == THREAD_READY)
+	{
+		ready_remove(t);
+		t->priority = priority;
+		// the running thread keeps running until something of a higher priority is ready
+		ready_insert(t, t == thread_current);
+		return;
+	}
+
+	t->priority = priority;
+	if (t->state == THREAD_BLOCKED)
+	{
+		m = t->waiting_on;
+		for (p = &m->waiters; *p != t; p = &(*p)->next);
+		*p = t->next;
+		for (p = &m->waiters; *p && (*p)->priority >= priority; p = &(*p)->next);
+		t->next = *p;
+		*p = t;
+	}
+}
+
+
+// the priority t should run at, its own or that of the highest thread waiting on a mutex it holds
+static uint8_t inherited_priority(thread_t *t)
+{
+	uint8_t priority = t->base_priority;
+	mutex_t *m;
+
+	for (m = t->held; m; m = m->next_held)
+		if (m->waiters && m->waiters->priority > priority)
+			priority = m->waiters->priority;
+	return priority;
+}
+
+
+thread_t * thread_pick(void)
+{
+	thread_current = ready_top();
+	return thread_current;
+}
+
+
+void thread_switch_done(uint32_t cycles)
+{
+	stats.switches++;
+	stats.switch_cycles = cycles;
+	if (cycles > stats.switch_cycles_max)
+		stats.switch_cycles_max = cycles;
+}
+
+
+static void thread_exit(void)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	ready_remove(thread_current);
+	thread_current->state = THREAD_DONE;
+	reschedule();
+	sys_unlock(lock);
+
+	// never gets here, the thread is not ready so it is never switched back to
+	while (1);
+}
+
+
+void thread_entry(void)
+{
+	thread_t *t = thread_current;
+
+	t->fn(t->arg);
+	thread_exit();
+}
+
+
+static void idle_fn(void *arg)
+{
+	while (1)
+		port_idle();
+}
+
+
+static void start_thread(thread_t *thread, void *stack, uint32_t stack_size, uint8_t priority, thread_fn_t fn, void *arg)
+{
+	sys_lock_t lock;
+
+	thread->priority = thread->base_priority = priority;
+	thread->notified = 0;
+	thread->fn = fn;
+	thread->arg = arg;
+	thread->waiting_on = NULL;
+	thread->held = NULL;
+	port_stack_init(thread, stack, stack_size);
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	make_ready(thread);
+	reschedule();
+	sys_unlock(lock);
+}
+
+
+void thread_init(void)
+{
+	main_thread.priority = main_thread.base_priority = THREAD_PRIORITY_SCHED;
+	main_thread.held = NULL;
+	main_thread.waiting_on = NULL;
+	make_ready(&main_thread);
+	thread_current = &main_thread;
+	port_init();
+
+	start_thread(&idle_thread, idle_stack, sizeof(idle_stack), THREAD_PRIORITY_IDLE, idle_fn, NULL);
+}
+
+
+int thread_create(thread_t *thread, void *stack, uint32_t stack_size, uint8_t priority, thread_fn_t fn, void *arg)
+{
+	if (priority <= THREAD_PRIORITY_SCHED || priority > THREAD_PRIORITY_MAX)
+		return -1;
+
+	start_thread(thread, stack, stack_size, priority, fn, arg);
+	return 0;
+}
+
+
+thread_t * thread_self(void)
+{
+	return thread_current;
+}
+
+
+void thread_yield(void)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	// move to the back of the fifo, the next thread at this priority is now the head
+	ready.head[thread_current->priority] = thread_current->next;
+	reschedule();
+	sys_unlock(lock);
+}
+
+
+void thread_sleep(uint32_t ticks)
+{
+	thread_t **p, *t = thread_current;
+	sys_lock_t lock;
+
+	if (ticks == 0)
+	{
+		thread_yield();
+		return;
+	}
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	ready_remove(t);
+	t->state = THREAD_SLEEPING;
+	t->wake = sys_get_tick() + ticks;
+	for (p = &sleepers; *p && sys_tick_diff((*p)->wake, t->wake) >= 0; p = &(*p)->next);
+	t->next = *p;
+	*p = t;
+
+	// the switch is made once the lock is released
+	reschedule();
+	sys_unlock(lock);
+}
+
+
+void thread_wait_notify(void)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	if (thread_current->notified)
+		thread_current->notified = 0;
+	else
+	{
+		ready_remove(thread_current);
+		thread_current->state = THREAD_WAITING;
+		reschedule();
+	}
+
+	sys_unlock(lock);
+}
+
+
+void thread_notify(thread_t *thread)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	if (thread->state == THREAD_WAITING)
+	{
+		make_ready(thread);
+		reschedule();
+	}
+	else
+		thread->notified = 1;
+
+	sys_unlock(lock);
+}
+
+
+void thread_tick(void)
+{
+	thread_t *t;
+	uint32_t now = sys_get_tick();
+	sys_lock_t lock;
+
+	// the sys tick runs this from the start, there is nothing to do until thread_init
+	if (thread_current == NULL)
+		return;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	while (sleepers && sys_tick_diff(sleepers->wake, now) >= 0)
+	{
+		t = sleepers;
+		sleepers = t->next;
+		make_ready(t);
+	}
+	reschedule();
+
+	sys_unlock(lock);
+}
+
+
+int thread_next_wake(uint32_t *tick)
+{
+	if (sleepers == NULL)
+		return 0;
+	*tick = sleepers->wake;
+	return 1;
+}
+
+
+void thread_get_stats(struct thread_stats_t *s)
+{
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	*s = stats;
+	sys_unlock(lock);
+}
+
+
+// the sys tick isr runs the thread tick
+void sys_tick_hook(void)
+{
+	thread_tick();
+}
+
+
+void mutex_init(mutex_t *mutex)
+{
+	mutex->owner = NULL;
+	mutex->waiters = NULL;
+	mutex->next_held = NULL;
+	mutex->count = 0;
+}
+
+
+static void take_mutex(mutex_t *m, thread_t *t)
+{
+	m->owner = t;
+	m->count = 1;
+	m->next_held = t->held;
+	t->held = m;
+}
+
+
+void mutex_lock(mutex_t *mutex)
+{
+	thread_t **p, *t = thread_current, *owner;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	if (mutex->owner == NULL)
+	{
+		take_mutex(mutex, t);
+		goto done;
+	}
+	if (mutex->owner == t)
+	{
+		mutex->count++;
+		goto done;
+	}
+
+	// wait in priority order, the unlock hands the mutex straight to the first waiter
+	ready_remove(t);
+	t->state = THREAD_BLOCKED;
+	t->waiting_on = mutex;
+	for (p = &mutex->waiters; *p && (*p)->priority >= t->priority; p = &(*p)->next);
+	t->next = *p;
+	*p = t;
+
+	// lend our priority to the owner, and on to the owner of the mutex it is blocked on
+	for (owner = mutex->owner; owner && owner->priority < t->priority; owner = owner->waiting_on->owner)
+	{
+		set_priority(owner, t->priority);
+		if (owner->state != THREAD_BLOCKED)
+			break;
+	}
+
+	reschedule();
+
+done:
+	sys_unlock(lock);
+}
+
+
+int mutex_unlock(mutex_t *mutex)
+{
+	thread_t *t = thread_current, *next;
+	mutex_t **p;
+	int ret = -1;
+	sys_lock_t lock;
+
+	lock = sys_lock(SYS_LOCK_KERNEL);
+
+	if (mutex->owner != t)
+		goto done;
+	ret = 0;
+	if (--mutex->count)
+		goto done;
+
+	for (p = &t->held; *p != mutex; p = &(*p)->next_held);
+	*p = mutex->next_held;
+	mutex->owner = NULL;
+
+	next = mutex->waiters;
+	if (next)
+	{
+		mutex->waiters = next->next;
+		next->waiting_on = NULL;
+		take_mutex(mutex, next);
+		// it may have inherited a priority from the threads still waiting
+		next->priority = inherited_priority(next);
+		make_ready(next);
+	}
+
+	// drop any priority lent to us for this mutex
+	set_priority(t, inherited_priority(t));
+	reschedule();
+
+done:
+	sys_unlock(lock);
+	return ret;
+}
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * @file sched_thread.h
+ *
+ * @brief optional preemptive priority threads for the mos scheduler
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note this is an opt in kernel mode (set SCHED_THREADS to 1). Threads have
+ * their own stacks and fixed priorities, the highest priority ready thread
+ * always runs and preempts lower priority threads as soon as it is ready (the
+ * switch is done in PendSV with lazy FPU stacking on the cortex m4). The
+ * thread that calls thread_init (ie main) becomes the THREAD_PRIORITY_SCHED
+ * thread, the lowest priority that runs user code, so sched_run_tasks in the
+ * main loop keeps running the run to completion tasks whenever no other
+ * thread is ready. Mutexes use priority inheritance so a low priority owner
+ * can't be held off by medium priority threads while a high priority thread
+ * waits for it. The task queue belongs to the main thread, other threads
+ * hand work to it with sched_post_from_isr. Blocking calls switch on leaving
+ * their lock (see sys_lock) so don't call them with a lock held.
+ *
+ */
+
+#include <stdint.h>
+
+#ifndef __SCHED_THREAD__
+#define __SCHED_THREAD__
+
+#ifndef SCHED_THREADS
+#define SCHED_THREADS (0)
+#endif
+
+#if SCHED_THREADS
+
+#if !defined(__arm__)
+#include <ucontext.h>
+#endif
+
+/**
+ * stack size of the internal idle thread (it only sleeps, the host port needs
+ * more for ucontext and the libc calls it makes)
+ */
+#ifndef SCHED_THREAD_IDLE_STACK
+#if defined(__arm__)
+#define SCHED_THREAD_IDLE_STACK (256)
+#else
+#define SCHED_THREAD_IDLE_STACK (65536)
+#endif
+#endif
+
+#define THREAD_PRIORITY_IDLE (0)		// internal idle thread
+#define THREAD_PRIORITY_SCHED (1)		// the main thread (running sched_run_tasks)
+#define THREAD_PRIORITY_MAX (31)
+
+#define THREAD_READY (0)
+#define THREAD_SLEEPING (1)				// in thread_sleep
+#define THREAD_BLOCKED (2)				// waiting for a mutex
+#define THREAD_WAITING (3)				// in thread_wait_notify
+#define THREAD_DONE (4)					// the thread function returned
+
+typedef struct thread_t thread_t;
+typedef struct mutex_t mutex_t;
+typedef void (*thread_fn_t)(void *arg);
+
+/**
+ * @brief thread state (allocated by the caller, the fields are managed by the kernel)
+ */
+struct thread_t
+{
+	uint32_t *sp;					// saved stack pointer (must be first, see the context switch)
+	uint8_t priority;				// current priority (raised while it owns a mutex a higher priority thread wants)
+	uint8_t base_priority;			// priority it was created with
+	uint8_t state;
+	uint8_t notified;				// thread_notify was called
+	uint32_t wake;					// tick to wake from thread_sleep
+	thread_fn_t fn;
+	void *arg;
+	thread_t *next, *prev;			// ready, sleep or mutex wait list
+	mutex_t *waiting_on;			// mutex the thread is blocked on
+	mutex_t *held;					// mutexes the thread owns
+#if !defined(__arm__)
+	ucontext_t ctx;					// host port context
+#endif
+};
+
+/**
+ * @brief mutex (recursive, with priority inheritance)
+ */
+struct mutex_t
+{
+	thread_t *owner;
+	thread_t *waiters;				// highest priority first
+	mutex_t *next_held;				// list of mutexes the owner holds
+	uint16_t count;					// recursive lock count
+};
+
+/**
+ * @brief context switch stats
+ */
+struct thread_stats_t
+{
+	uint32_t switches;				// number of context switches
+	uint32_t switch_cycles;			// cycles from requesting the last switch until the new thread's context was being restored
+	uint32_t switch_cycles_max;		// worst case switch_cycles
+};
+
+
+/**
+ * @brief start the kernel, the calling thread (ie main) becomes the THREAD_PRIORITY_SCHED thread
+ * @note call this once after sys_init and before any other thread function
+ */
+void thread_init(void);
+
+
+/**
+ * @brief create and start a thread
+ * @param thread thread state
+ * @param stack memory for the thread stack (8 byte aligned)
+ * @param stack_size size of stack in bytes
+ * @param priority THREAD_PRIORITY_SCHED + 1 to THREAD_PRIORITY_MAX (higher runs first)
+ * @param fn thread function, the thread ends if it returns
+ * @param arg passed to fn
+ * @return 0 on success, -1 if the priority is invalid
+ * @note if the new thread has a higher priority than the caller it runs straight away
+ */
+int thread_create(thread_t *thread, void *stack, uint32_t stack_size, uint8_t priority, thread_fn_t fn, void *arg);
+
+
+/**
+ * @brief get the running thread
+ */
+thread_t * thread_self(void);
+
+
+/**
+ * @brief let the other ready threads at the same priority run
+ */
+void thread_yield(void);
+
+
+/**
+ * @brief block the running thread for a number of ticks
+ * @param ticks number of sys ticks to sleep (0 just yields)
+ */
+void thread_sleep(uint32_t ticks);
+
+
+/**
+ * @brief block the running thread until thread_notify is called for it (returns
+ * straight away if it was notified since the last wait)
+ */
+void thread_wait_notify(void);
+
+
+/**
+ * @brief wake a thread blocked in thread_wait_notify (safe from isrs)
+ * @param thread thread to wake
+ */
+void thread_notify(thread_t *thread);
+
+
+/**
+ * @brief get the context switch stats
+ * @param stats filled in with a copy of the stats
+ */
+void thread_get_stats(struct thread_stats_t *stats);
+
+
+/**
+ * @brief run the kernel tick (sleep timeouts and preemption), called from the sys tick isr
+ * @note it does nothing until thread_init has run
+ */
+void thread_tick(void);
+
+
+/**
+ * @brief get the tick the first sleeping thread wakes at (used by sched_next_deadline)
+ * @param tick set to the wake tick
+ * @return 1 if a thread is sleeping, else 0
+ * @note call with the kernel lock held (see sys_lock)
+ */
+int thread_next_wake(uint32_t *tick);
+
+
+/**
+ * @brief init a mutex (unlocked)
+ */
+void mutex_init(mutex_t *mutex);
+
+
+/**
+ * @brief lock a mutex, blocking until it is free
+ * @param mutex mutex to lock (the owner can lock it again, it must unlock it the same number of times)
+ * @note while blocked the owner runs at the priority of the highest waiter if that is higher
+ */
+void mutex_lock(mutex_t *mutex);
+
+
+/**
+ * @brief unlock a mutex, the highest priority waiter gets it next
+ * @param mutex mutex to unlock
+ * @return 0 on success, -1 if the running thread does not own the mutex
+ */
+int mutex_unlock(mutex_t *mutex);
+
+#endif
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * @file sched_thread_cm4.c
+ *
+ * @brief thread port for the cortex m4, the switch is made in PendSV
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note threads run on the process stack and isrs on their own main stack.
+ * PendSV has the lowest priority so a switch requested from an isr or with
+ * a lock held (see sys_lock) happens as soon as nothing else is running. Only r4-r11
+ * (and s16-s31 if the thread has used the fpu) are saved by hand, the rest is
+ * stacked by the exception entry, lazily for the fpu registers (LSPEN), so a
+ * thread that has not used the fpu doesn't pay for it
+ *
+ */
+
+
+#include <hal.h>
+#include "sched_thread.h"
+#include "sched_thread_port.h"
+
+#if SCHED_THREADS && defined(__arm__)
+
+#include <stm32f4xx.h>
+
+/**
+ * size of the stack isrs run on once the threads have taken over the main stack
+ */
+#ifndef SCHED_THREAD_ISR_STACK
+#define SCHED_THREAD_ISR_STACK (1024)
+#endif
+
+#define EXC_RETURN_THREAD_PSP (0xfffffffd)	// return to thread mode on the psp without fpu state
+#define XPSR_THUMB (0x01000000)
+
+static uint64_t isr_stack[SCHED_THREAD_ISR_STACK / sizeof(uint64_t)];
+static uint32_t switch_start;
+
+
+void port_init(void)
+{
+	// main carries on on the process stack (at the same address), the main stack moves to isr_stack
+	__set_PSP(__get_MSP());
+	__set_CONTROL(__get_CONTROL() | CONTROL_SPSEL_Msk);
+	__ISB();
+	__set_MSP((uint32_t)&isr_stack[sizeof(isr_stack) / sizeof(isr_stack[0])]);
+
+	// fpu context is only stacked for threads that used it
+	FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+
+	NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+}
+
+
+void port_stack_init(thread_t *thread, void *stack, uint32_t stack_size)
+{
+	// the exception frame must be 8 byte aligned
+	uint32_t *sp = (uint32_t *)(((uint32_t)stack + stack_size) & ~7);
+
+	// hardware frame, popped on the exception return
+	*--sp = XPSR_THUMB;							// xpsr
+	*--sp = (uint32_t)thread_entry & ~1;		// pc
+	*--sp = 0;									// lr (thread_entry never returns)
+	*--sp = 0;									// r12
+	*--sp = 0;									// r3
+	*--sp = 0;									// r2
+	*--sp = 0;									// r1
+	*--sp = 0;									// r0
+
+	// software frame, popped in PendSV
+	*--sp = EXC_RETURN_THREAD_PSP;				// lr
+	sp -= 8;									// r4 - r11
+
+	thread->sp = sp;
+}
+
+
+void port_switch(void)
+{
+	// a second request before the first is taken is the same switch
+	if (!(SCB->ICSR & SCB_ICSR_PENDSVSET_Msk))
+	{
+		switch_start = sys_get_cycles();
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
+
+
+void port_idle(void)
+{
+	__WFI();
+}
+
+
+// called from PendSV with the old thread's registers saved on its stack, returns the new thread's stack
+__attribute__((used)) uint32_t * port_switch_sp(uint32_t *sp)
+{
+	sys_lock_t lock;
+
+	// only the isrs that can call the kernel are held off while picking
+	lock = sys_lock(SYS_LOCK_KERNEL);
+	thread_current->sp = sp;
+	sp = thread_pick()->sp;
+	thread_switch_done(sys_get_cycles() - switch_start);
+	sys_unlock(lock);
+	return sp;
+}
+
+
+__attribute__((naked)) void PendSV_Handler(void)
+{
+	__asm volatile(
+		"	mrs r0, psp\n"
+		"	isb\n"
+#if __FPU_USED
+		// bit 4 of EXC_RETURN is clear if the thread has fpu state
+		"	tst lr, #0x10\n"
+		"	it eq\n"
+		"	vstmdbeq r0!, {s16-s31}\n"
+#endif
+		"	stmdb r0!, {r4-r11, lr}\n"
+		"	bl port_switch_sp\n"
+		"	ldmia r0!, {r4-r11, lr}\n"
+#if __FPU_USED
+		"	tst lr, #0x10\n"
+		"	it eq\n"
+		"	vldmiaeq r0!, {s16-s31}\n"
+#endif
+		"	msr psp, r0\n"
+		"	isb\n"
+		"	bx lr\n"
+	);
+}
+
+#endif
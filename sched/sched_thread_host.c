@@ -0,0 +1,80 @@
+/**
+ * @file sched_thread_host.c
+ *
+ * @brief thread port for host builds, threads are ucontexts
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note there are no interrupts on the host so a switch happens straight away
+ * at the kernel call that makes a higher priority thread ready (ie preemption
+ * is only at kernel calls), the idle thread moves the tick on to the next
+ * sleeper so tests run without waiting
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <hal.h>
+#include "sched_thread.h"
+#include "sched_thread_port.h"
+
+#if SCHED_THREADS && !defined(__arm__)
+
+static uint32_t switch_start;
+
+
+static void host_entry(void)
+{
+	thread_switch_done(sys_get_cycles() - switch_start);
+	thread_entry();
+}
+
+
+void port_init(void)
+{
+}
+
+
+void port_stack_init(thread_t *thread, void *stack, uint32_t stack_size)
+{
+	getcontext(&thread->ctx);
+	thread->ctx.uc_stack.ss_sp = stack;
+	thread->ctx.uc_stack.ss_size = stack_size;
+	thread->ctx.uc_link = NULL;
+	makecontext(&thread->ctx, host_entry, 0);
+}
+
+
+void port_switch(void)
+{
+	thread_t *prev = thread_current, *next;
+
+	switch_start = sys_get_cycles();
+	next = thread_pick();
+	if (next == prev)
+		return;
+	swapcontext(&prev->ctx, &next->ctx);
+
+	// back in prev once something switches to it again
+	thread_switch_done(sys_get_cycles() - switch_start);
+}
+
+
+void port_idle(void)
+{
+	uint32_t tick;
+
+	// every thread is waiting and nothing can wake them on the host
+	if (!thread_next_wake(&tick))
+	{
+		fprintf(stderr, "sched_thread: deadlock, no thread can run\n");
+		exit(1);
+	}
+	sys_idle_until(tick);
+	thread_tick();
+}
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file sched_thread_port.h
+ *
+ * @brief internal interface between the thread kernel and its cpu ports
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note this is not part of the public interface, it is shared by
+ * sched_thread.c and the sched_thread_<port>.c files only. The kernel keeps
+ * the thread lists, the port only has to switch stacks (sched_thread_cm4.c
+ * for the cortex m4 and sched_thread_host.c for ucontext on a pc)
+ *
+ */
+
+#include <stdint.h>
+#include "sched_thread.h"
+
+#ifndef __SCHED_THREAD_PORT__
+#define __SCHED_THREAD_PORT__
+
+#if SCHED_THREADS
+
+/**
+ * @brief the running thread (set by thread_pick)
+ */
+extern thread_t *thread_current;
+
+
+/**
+ * @brief pick the highest priority ready thread to run next and make it current
+ * @return the new current thread
+ * @note the ports call this from the switch with interrupts disabled
+ */
+thread_t * thread_pick(void);
+
+
+/**
+ * @brief record how long a switch took (see struct thread_stats_t)
+ * @param cycles sys_get_cycles from requesting the switch to restoring the new thread
+ */
+void thread_switch_done(uint32_t cycles);
+
+
+/**
+ * @brief the entry point of every thread, runs thread->fn and ends the thread when it returns
+ */
+void thread_entry(void);
+
+
+/**
+ * @brief set up the cpu for threads (the calling context becomes thread_current)
+ */
+void port_init(void);
+
+
+/**
+ * @brief set up a new thread so the first switch to it starts thread_entry
+ * @param thread new thread (thread->fn and arg are set)
+ * @param stack stack memory
+ * @param stack_size size of stack in bytes
+ */
+void port_stack_init(thread_t *thread, void *stack, uint32_t stack_size);
+
+
+/**
+ * @brief switch to the thread returned by thread_pick, on the target this is
+ * pended and happens once the kernel lock is released (see sys_unlock), on
+ * the host it happens straight away
+ */
+void port_switch(void);
+
+
+/**
+ * @brief wait for something to happen (run by the idle thread)
+ */
+void port_idle(void);
+
+#endif
+
+#endif
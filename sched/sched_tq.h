@@ -0,0 +1,114 @@
+/**
+ * @file sched_tq.h
+ *
+ * @brief internal interface between the scheduler and its time queue backends
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note this is not part of the public interface, it is shared by sched.c and
+ * the sched_<backend>.c files only. The time queue holds all the tasks waiting
+ * to run, sched.c owns the task memory and the critical sections, the backend
+ * only has to order the tasks. Once a task is late it is popped from the
+ * time queue and put on the ready queue for its priority (see sched.c).
+ *
+ */
+
+#include <stdint.h>
+#include "sched.h"
+
+#ifndef __SCHED_TQ__
+#define __SCHED_TQ__
+
+// the argument words also hold a sched_add_task_ctx payload
+#define TASK_CTX_WORDS ((SCHED_CTX_SIZE + 3) / 4)
+#define TASK_ARGV_WORDS (TASK_CTX_WORDS > SCHED_MAX_TASK_PARAMS ? TASK_CTX_WORDS : SCHED_MAX_TASK_PARAMS)
+
+struct task_info_t
+{
+	task_id_t task_id;
+	uint32_t time;
+	int priority;
+	void *cb;
+	uint8_t argc;						// number of arguments (or the payload length for a ctx task)
+	uint8_t ctx;						// argv holds a payload, see sched_add_task_ctx
+	uint32_t argv[TASK_ARGV_WORDS];
+	uint32_t period;					// release period of a periodic task (0 for one shot tasks)
+	uint32_t overruns;					// number of periods skipped because the task ran late
+	uint8_t state;						// which queue the task is on (TASK_FREE, TASK_TIMED, TASK_READY)
+	struct task_info_t *next, *prev;	// double link list for speed (list/wheel backend, ready queues and free list)
+#if SCHED_BACKEND != SCHED_BACKEND_LIST
+	int idx;							// position of this task in the backend (heap index, wheel slot)
+#endif
+#if SCHED_POLICY == SCHED_POLICY_EDF
+	uint32_t deadline;					// relative deadline (see sched_set_deadline)
+#endif
+#if SCHED_EVENTS
+	struct task_info_t **wait_list;		// event or queue wait list the task is on (NULL if it is not waiting)
+	struct task_info_t *wait_next;		// next task on the wait list
+#endif
+#if SCHED_SLACK
+	uint32_t slack;						// a slack task is queued at time + slack (see sched_add_task_slack)
+	struct task_info_t *slack_next;		// slack task list in start time order
+#endif
+};
+
+#define TASK_FREE (0)					// on the free list
+#define TASK_TIMED (1)					// in the time queue waiting for its time
+#define TASK_READY (2)					// late and in a ready queue waiting to run
+#define TASK_BATCH (3)					// detached by sched_run_for and waiting to run
+#define TASK_WAITING (4)				// on a wait list with no timeout (not in the time queue)
+
+
+/**
+ * bytes of backend memory needed per task when the task pool is supplied by
+ * the user (see sched_init_pool), the heap needs a slot pointer per task
+ */
+#if SCHED_BACKEND == SCHED_BACKEND_HEAP
+#define TQ_TASK_BYTES (sizeof(struct task_info_t *))
+#else
+#define TQ_TASK_BYTES (0)
+#endif
+
+
+/**
+ * @brief reset the time queue so it is empty
+ * @param mem TQ_TASK_BYTES per task for the backend (NULL to use the static memory sized for SCHED_MAX_TASKS)
+ * @param tasks number of tasks in the pool
+ */
+void tq_init(void *mem, uint32_t tasks);
+
+
+/**
+ * @brief add a task to the time queue
+ * @param task the task to add (time and priority must be set)
+ */
+void tq_insert(struct task_info_t *task);
+
+
+/**
+ * @brief remove a task from the time queue
+ * @param task the task to remove, it must be in the queue
+ */
+void tq_remove(struct task_info_t *task);
+
+
+/**
+ * @brief get the time of the earliest task in the time queue
+ * @param time set to the time of the earliest task (an earlier time is allowed if
+ * the backend cannot tell exactly, this is only used to decide how long to idle)
+ * @return 1 if the queue has tasks, else 0 (time is not set)
+ */
+int tq_next_time(uint32_t *time);
+
+
+/**
+ * @brief remove the next late task from the time queue
+ * @param now the current time
+ * @return the late task with the earliest time (it is removed from the queue)
+ * or NULL if no tasks are late
+ */
+struct task_info_t *tq_pop_late(uint32_t now);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file sched_wait.h
+ *
+ * @brief internal interface for tasks that wait on an event or a queue
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ * @note this is not part of the public interface, it is shared by sched.c and
+ * sched_event.c only. A waiting task is on the wait list of the event or queue
+ * and, if it has a timeout, in the time queue as well. Whichever comes first
+ * makes it ready, a wake passes a value as the second callback argument and a
+ * timeout passes 0.
+ *
+ */
+
+#include <stdint.h>
+#include "sched_tq.h"
+
+#ifndef __SCHED_WAIT__
+#define __SCHED_WAIT__
+
+/**
+ * @brief add a task that waits on a wait list (call from a critical section)
+ * @param list wait list (the task is added at the end)
+ * @param timeout ticks until the task runs anyway (0 to wait forever)
+ * @param priority see sched_add_task
+ * @param callback run as callback(arg, value) once woken or timed out
+ * @param arg first callback argument
+ * @param data kept in the second callback argument until the task is woken (ie an event mask)
+ * @return the task or NULL if no task is free
+ */
+struct task_info_t * wait_add(struct task_info_t **list, uint32_t timeout, uint8_t priority, void *callback, uint32_t arg, uint32_t data);
+
+
+/**
+ * @brief make a waiting task ready to run now (call from a critical section)
+ * @param task task on a wait list, it is removed from the list and the time queue
+ * @param value passed as the second callback argument
+ */
+void wait_wake(struct task_info_t *task, uint32_t value);
+
+#endif
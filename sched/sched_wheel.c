@@ -0,0 +1,273 @@
+/**
+ * @file sched_wheel.c
+ *
+ * @brief hierarchical timing wheel backend for the mos scheduler
+ *
+ * tasks are hashed into a slot of one of the wheel levels by their time,
+ * level 0 has a slot per tick, level 1 a slot per 64 ticks, etc. As the
+ * wheel turns (following SCHED_CLOCK) the higher level slots are cascaded
+ * down and the level 0 slots are moved on to a time sorted late list. Insert
+ * and remove are O(1) and expiry is amortised O(1) per task, which suits
+ * thousands of timeouts that are mostly cancelled before they expire (see
+ * SCHED_BACKEND)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <string.h>
+#include <hal.h>
+#include "sched_tq.h"
+
+#if SCHED_BACKEND == SCHED_BACKEND_WHEEL
+
+#define WHEEL_BITS (6)
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS (6)			// 6 levels of 6 bits cover the whole 32 bit tick
+#define WHEEL_LATE (-1)				// task->idx for tasks on the late list
+
+struct wheel_t
+{
+	uint32_t next;										// next tick to process (all earlier ticks are done)
+	int count;											// number of tasks in the wheel slots
+	int upper;											// number of those in levels 1 and up
+	uint64_t occupied;									// bit per level 0 slot that has tasks
+	struct task_info_t *slot[WHEEL_LEVELS][WHEEL_SIZE];	// unsorted lists of tasks
+	struct task_info_t *late_head, *late_tail;			// expired tasks sorted by time
+};
+static struct wheel_t wheel;
+
+
+void tq_init(void *mem, uint32_t tasks)
+{
+	memset(&wheel, 0, sizeof(wheel));
+	wheel.next = SCHED_CLOCK();
+}
+
+
+// add task to the late list keeping it sorted by time (tasks normally
+// arrive in time order so this is a quick append)
+static void late_insert(struct task_info_t *task)
+{
+	struct task_info_t *t;
+
+	for (t = wheel.late_tail; t; t = t->prev)
+		if (sys_tick_diff(t->time, task->time) >= 0)
+			break;
+
+	task->prev = t;
+	task->next = t ? t->next : wheel.late_head;
+	if (task->next)
+		task->next->prev = task;
+	else
+		wheel.late_tail = task;
+	if (t)
+		t->next = task;
+	else
+		wheel.late_head = task;
+	task->idx = WHEEL_LATE;
+}
+
+
+// hash the task into the wheel relative to the next tick to process
+static void wheel_insert(struct task_info_t *task)
+{
+	int32_t delta = sys_tick_diff(wheel.next, task->time);
+	int level, n;
+
+	if (delta < 0)
+	{
+		// this tick has already been processed so it is late
+		late_insert(task);
+		return;
+	}
+
+	// find the lowest level that can hold this delta
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (((uint32_t)delta >> (WHEEL_BITS * (level + 1))) == 0)
+			break;
+
+	n = (task->time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	task->idx = level * WHEEL_SIZE + n;
+	task->prev = NULL;
+	task->next = wheel.slot[level][n];
+	if (task->next)
+		task->next->prev = task;
+	wheel.slot[level][n] = task;
+	wheel.count++;
+	if (level == 0)
+		wheel.occupied |= (uint64_t)1 << n;
+	else
+		wheel.upper++;
+}
+
+
+// re-hash all the tasks in a slot (they now fit in a lower level)
+static void cascade(int level, int n)
+{
+	struct task_info_t *t = wheel.slot[level][n], *next;
+
+	wheel.slot[level][n] = NULL;
+	for (; t; t = next)
+	{
+		next = t->next;
+		wheel.count--;
+		wheel.upper--;
+		wheel_insert(t);
+	}
+}
+
+
+// process the next tick, cascading higher levels when a lower level wraps
+// and then moving the tasks due this tick to the late list
+static void wheel_tick(void)
+{
+	uint32_t tick = wheel.next;
+	struct task_info_t *t, *next;
+	int level, n;
+
+	// wheel.next is still this tick while cascading so any cascaded tasks
+	// due this tick land in level 0 of the current slot and are picked up below
+	for (level = 1; level < WHEEL_LEVELS; level++)
+	{
+		if ((tick >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK)
+			break;
+		cascade(level, (tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+	}
+
+	n = tick & WHEEL_MASK;
+	t = wheel.slot[0][n];
+	wheel.slot[0][n] = NULL;
+	wheel.occupied &= ~((uint64_t)1 << n);
+	wheel.next = tick + 1;
+	for (; t; t = next)
+	{
+		next = t->next;
+		wheel.count--;
+		late_insert(t);
+	}
+}
+
+
+// turn the wheel until every tick up to and including now is processed
+static void wheel_advance(uint32_t now)
+{
+	while (sys_tick_diff(wheel.next, now) >= 0)
+	{
+		uint32_t n = wheel.next & WHEEL_MASK;
+
+		if (wheel.count == 0)
+		{
+			// the wheel is empty, nothing to cascade or expire
+			wheel.next = now + 1;
+			break;
+		}
+
+		if (n != 0 && (wheel.occupied >> n) == 0)
+		{
+			// nothing left in level 0 before it wraps so skip straight to the
+			// wrap (or now) instead of processing the empty ticks one at a time
+			uint32_t skip = WHEEL_SIZE - n;
+			if ((uint32_t)sys_tick_diff(wheel.next, now) < skip)
+				skip = sys_tick_diff(wheel.next, now) + 1;
+			wheel.next += skip;
+			continue;
+		}
+		wheel_tick();
+	}
+}
+
+
+void tq_insert(struct task_info_t *task)
+{
+	wheel_insert(task);
+}
+
+
+void tq_remove(struct task_info_t *task)
+{
+	struct task_info_t *prev = task->prev, *next = task->next;
+
+	if (next)
+		next->prev = prev;
+	if (prev)
+		prev->next = next;
+
+	if (task->idx == WHEEL_LATE)
+	{
+		if (task == wheel.late_head)
+			wheel.late_head = next;
+		if (task == wheel.late_tail)
+			wheel.late_tail = prev;
+	}
+	else
+	{
+		int level = task->idx / WHEEL_SIZE, n = task->idx & WHEEL_MASK;
+		if (prev == NULL)
+			// task is at the head of its slot
+			wheel.slot[level][n] = next;
+		if (level == 0 && wheel.slot[0][n] == NULL)
+			wheel.occupied &= ~((uint64_t)1 << n);
+		if (level != 0)
+			wheel.upper--;
+		wheel.count--;
+	}
+	task->next = task->prev = NULL;
+}
+
+
+int tq_next_time(uint32_t *time)
+{
+	uint32_t n, k;
+
+	if (wheel.late_head)
+	{
+		*time = wheel.late_head->time;
+		return 1;
+	}
+	if (wheel.count == 0)
+		return 0;
+
+	// tasks in the upper levels can't be due before the next cascade (at most
+	// 64 ticks away), report that rather than search the unsorted slots
+	n = wheel.next & WHEEL_MASK;
+	if (n == 0 && wheel.upper)
+	{
+		// the wheel is parked on a block boundary, the cascade is due now
+		*time = wheel.next;
+		return 1;
+	}
+	k = WHEEL_SIZE - n;
+	if (wheel.occupied)
+	{
+		// level 0 holds the next 64 ticks so the first occupied slot from the
+		// current position is the exact time of the earliest task in level 0,
+		// past the cascade an upper level task may be due first
+		for (k = 0; k < WHEEL_SIZE - n; k++)
+			if (wheel.occupied & ((uint64_t)1 << (n + k)))
+				break;
+	}
+	*time = wheel.next + k;
+	return 1;
+}
+
+
+struct task_info_t *tq_pop_late(uint32_t now)
+{
+	struct task_info_t *t;
+
+	wheel_advance(now);
+
+	// the late list is sorted by time so the head is the earliest
+	t = wheel.late_head;
+	if (t)
+		tq_remove(t);
+
+	return t;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#!/usr/bin/python
+import struct
+import sys
+import os
+import io
+import mos_elf
+import log_decode
+import trace_json
+
+
+def show_help():
+	print("%s - Decode a mos crash dump (struct sys_crash_t, see sys_get_last_crash)" % sys.argv[0])
+	print("(ie sent out of a uart or saved from gdb with \"dump binary value crash.bin sys_crash\")\n")
+	print("Usage: %s [-h] [-c <cpu_hz>] <elf> <crash.bin>" % sys.argv[0])
+
+
+SYS_CRASH_MAGIC = 0x43525348
+
+CFSR_BITS = [
+	(0, "IACCVIOL: instruction fetch from a no execute region"),
+	(1, "DACCVIOL: data access violation (MMFAR)"),
+	(3, "MUNSTKERR: mem manage fault unstacking"),
+	(4, "MSTKERR: mem manage fault stacking"),
+	(5, "MLSPERR: mem manage fault saving the fp state"),
+	(8, "IBUSERR: instruction bus error"),
+	(9, "PRECISERR: precise data bus error (BFAR)"),
+	(10, "IMPRECISERR: imprecise data bus error (the pc is after the access)"),
+	(11, "UNSTKERR: bus fault unstacking"),
+	(12, "STKERR: bus fault stacking (ie a stack overflow)"),
+	(13, "LSPERR: bus fault saving the fp state"),
+	(16, "UNDEFINSTR: undefined instruction"),
+	(17, "INVSTATE: invalid state (ie a call to an address without the thumb bit)"),
+	(18, "INVPC: invalid exception return"),
+	(19, "NOCP: no coprocessor (ie the fpu is off)"),
+	(24, "UNALIGNED: unaligned access"),
+	(25, "DIVBYZERO: divide by zero"),
+]
+MMARVALID = 1 << 7
+BFARVALID = 1 << 15
+
+HFSR_BITS = [
+	(1, "VECTTBL: vector table read fault"),
+	(30, "FORCED: a configurable fault escalated (see the cfsr)"),
+	(31, "DEBUGEVT: debug event"),
+]
+
+
+def read_crash(filename):
+	data = open(filename, "rb").read()
+	if len(data) < 80:
+		sys.exit("%s is too short to be a crash dump" % filename)
+	c = {}
+	(c["magic"], c["exception"], c["exc_return"], c["tick"]) = struct.unpack("<4I", data[0:16])
+	c["frame"] = struct.unpack("<8I", data[16:48])
+	(c["sp"], c["cfsr"], c["hfsr"], c["mmfar"], c["bfar"]) = struct.unpack("<5I", data[48:68])
+	(stack_size, stack_words, trace_size, log_size) = struct.unpack("<4H", data[68:76])
+	log_words, = struct.unpack("<I", data[76:80])
+	if c["magic"] != SYS_CRASH_MAGIC:
+		sys.exit("%s is not a crash dump (bad magic 0x%08x)" % (filename, c["magic"]))
+	words = (80 // 4) + stack_size + trace_size * 2 + log_size + 1
+	if len(data) < words * 4:
+		sys.exit("%s is truncated" % filename)
+	w = struct.unpack("<%dI" % words, data[:words * 4])
+	if sum(w[:-1]) & 0xffffffff != w[-1]:
+		sys.stderr.write("warning: the check sum is wrong, the dump may be corrupt\n")
+	k = 80 // 4
+	c["stack"] = w[k:k + min(stack_words, stack_size)]
+	k += stack_size
+	c["trace"] = [(w[k + n * 2], w[k + n * 2 + 1]) for n in range(trace_size)]
+	k += trace_size * 2
+	c["log"] = w[k:k + min(log_words, log_size)]
+	return c
+
+
+def code(elf, addr):
+	# return addresses have the thumb bit set, back up into the call
+	name = elf.symbolise((addr & ~1) - (addr & 1) * 2, True)
+	return " <%s>" % name if name else ""
+
+
+def show(elf, crash, cpu_hz):
+	sys.stdout.write("%s at tick %d (exc_return 0x%08x, %s stack)\n" % (mos_elf.isr_name(elf, crash["exception"]),
+		crash["tick"], crash["exc_return"], "process" if crash["exc_return"] & 0x4 else "main"))
+
+	r0, r1, r2, r3, r12, lr, pc, xpsr = crash["frame"]
+	sys.stdout.write("\n  pc   0x%08x%s\n" % (pc, code(elf, pc & ~1)))
+	sys.stdout.write("  lr   0x%08x%s\n" % (lr, code(elf, lr)))
+	sys.stdout.write("  sp   0x%08x\n" % crash["sp"])
+	sys.stdout.write("  r0   0x%08x  r1 0x%08x  r2 0x%08x  r3 0x%08x  r12 0x%08x\n" % (r0, r1, r2, r3, r12))
+	sys.stdout.write("  xpsr 0x%08x (exception %d)\n" % (xpsr, xpsr & 0x1ff))
+
+	sys.stdout.write("\n  cfsr 0x%08x\n" % crash["cfsr"])
+	for bit, text in CFSR_BITS:
+		if crash["cfsr"] & (1 << bit):
+			sys.stdout.write("    %s\n" % text)
+	if crash["cfsr"] & MMARVALID:
+		sys.stdout.write("    mmfar 0x%08x%s\n" % (crash["mmfar"], code(elf, crash["mmfar"])))
+	if crash["cfsr"] & BFARVALID:
+		sys.stdout.write("    bfar  0x%08x%s\n" % (crash["bfar"], code(elf, crash["bfar"])))
+	sys.stdout.write("  hfsr 0x%08x\n" % crash["hfsr"])
+	for bit, text in HFSR_BITS:
+		if crash["hfsr"] & (1 << bit):
+			sys.stdout.write("    %s\n" % text)
+
+	# anything that looks like a return address is a clue to the call chain
+	sys.stdout.write("\nstack (%d words)\n" % len(crash["stack"]))
+	for k, w in enumerate(crash["stack"]):
+		sys.stdout.write("  0x%08x: 0x%08x%s\n" % (crash["sp"] + k * 4, w, code(elf, w) if w & 1 else ""))
+
+	trace = [t for t in crash["trace"] if t[1] != 0]
+	if trace:
+		sys.stdout.write("\ntrace (last %d records)\n" % len(trace))
+		names = trace_json.Names(elf)
+		for cycles, what in trace:
+			event, obj = what >> 24, what & 0xffffff
+			if event < len(trace_json.EVENT_NAMES):
+				name = trace_json.EVENT_NAMES[event]
+			else:
+				name = "event %d" % event
+			if event in (trace_json.ISR_ENTER, trace_json.ISR_EXIT):
+				name += " " + names.isr(obj)
+			else:
+				name += " " + names.obj(obj)
+			sys.stdout.write("  %12.6f %s\n" % (-((trace[-1][0] - cycles) & 0xffffffff) / float(cpu_hz), name))
+
+	if crash["log"]:
+		sys.stdout.write("\nlog (%d words not sent)\n" % len(crash["log"]))
+		log = io.BytesIO(struct.pack("<%dI" % len(crash["log"]), *crash["log"]))
+		log_decode.decode(log_decode.elf_section(elf.filename, ".mos_log"), log, cpu_hz)
+
+
+# check args
+if __name__ == "__main__":
+	args = sys.argv[1:]
+	if "-h" in args:
+		show_help()
+		sys.exit(0)
+	cpu_hz = 168000000
+	while len(args) > 2 and args[0] == "-c":
+		cpu_hz = int(args[1])
+		args = args[2:]
+	if len(args) != 2:
+		show_help()
+		sys.exit(1)
+	if not os.path.exists(args[0]):
+		sys.exit("Unable open elf %s" % args[0])
+	if not os.path.exists(args[1]):
+		sys.exit("Unable open crash dump %s" % args[1])
+
+	show(mos_elf.Elf(args[0]), read_crash(args[1]), cpu_hz)
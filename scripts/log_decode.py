@@ -0,0 +1,123 @@
+#!/usr/bin/python
+import struct
+import sys
+import os
+import re
+import mos_elf
+
+
+def show_help():
+	print("%s - Decode the binary sys_log output of a mos program" % sys.argv[0])
+	print("(the format strings are read from the .mos_log section of the program's elf)\n")
+	print("Usage: %s [-h] [-c <cpu_hz>] [-b <baud>] <elf> <log>" % sys.argv[0])
+	print("  <log> is a file of captured uart output or a serial port (ie /dev/ttyUSB0, needs pyserial)")
+
+
+LOG_SYNC = 0xa5
+LOG_MAX_ARGS = 4
+
+
+# get the contents of a section from the elf
+def elf_section(filename, name):
+	data = mos_elf.Elf(filename).section_data(name)
+	if data is None:
+		sys.exit("%s has no %s section (no sys_log calls or not linked with the mos linker scripts)" % (filename, name))
+	return data
+
+
+# printf a record, the arguments are raw 32bit words
+conv_re = re.compile(r"%([-+ #0]*[0-9]*(?:\.[0-9]+)?)(?:hh|h|ll|l|z|j|t)?([diouxXcfeEgGsp%])")
+def format_record(fmt, args):
+	args = list(args)
+	def conv(m):
+		flags, c = m.group(1), m.group(2)
+		if c == "%":
+			return "%"
+		if not args:
+			return "<missing>"
+		a = args.pop(0)
+		if c in "di":
+			return ("%" + flags + "d") % struct.unpack("<i", struct.pack("<I", a))[0]
+		if c in "ouxX":
+			return ("%" + flags + c.replace("u", "d")) % a
+		if c == "c":
+			return ("%" + flags + "c") % chr(a & 0xff)
+		if c in "feEgG":
+			return ("%" + flags + c) % struct.unpack("<f", struct.pack("<I", a))[0]
+		# strings are not copied into the log, show where they were
+		return "0x%08x" % a
+	return conv_re.sub(conv, fmt)
+
+
+def read_words(f):
+	while True:
+		b = f.read(4)
+		while len(b) < 4:
+			more = f.read(4 - len(b))
+			if not more:
+				return
+			b += more
+		yield struct.unpack("<I", b)[0]
+
+
+def decode(strings, f, cpu_hz):
+	words = read_words(f)
+	time = None
+	last = 0
+	for header in words:
+		argc = (header >> 16) & 0xff
+		if header >> 24 != LOG_SYNC or argc > LOG_MAX_ARGS:
+			# out of step (ie started listening part way through a record)
+			continue
+		try:
+			cycles = next(words)
+			args = [next(words) for k in range(argc)]
+		except StopIteration:
+			return
+
+		# the cycle count wraps (every ~25s at 168MHz) so count the wraps,
+		# assuming records are never further apart than that
+		if time is None:
+			time = cycles
+		else:
+			time += (cycles - last) & 0xffffffff
+		last = cycles
+
+		fmt_id = header & 0xffff
+		if fmt_id >= len(strings):
+			fmt = "<unknown format id %d>" % fmt_id
+		else:
+			fmt = strings[fmt_id:strings.index(b"\0", fmt_id)].decode("latin-1")
+		sys.stdout.write("%12.6f %s\n" % (float(time) / cpu_hz, format_record(fmt, args)))
+		sys.stdout.flush()
+
+
+# check args
+if __name__ == "__main__":
+	args = sys.argv[1:]
+	if "-h" in args:
+		show_help()
+		sys.exit(0)
+	cpu_hz = 168000000
+	baud = 115200
+	while len(args) > 2 and args[0] in ("-c", "-b"):
+		if args[0] == "-c":
+			cpu_hz = int(args[1])
+		else:
+			baud = int(args[1])
+		args = args[2:]
+	if len(args) != 2:
+		show_help()
+		sys.exit(1)
+	if not os.path.exists(args[0]):
+		sys.exit("Unable open elf %s" % args[0])
+	if not os.path.exists(args[1]):
+		sys.exit("Unable open log %s" % args[1])
+
+	strings = elf_section(args[0], ".mos_log")
+	if args[1].startswith("/dev/"):
+		import serial
+		log = serial.Serial(args[1], baud)
+	else:
+		log = open(args[1], "rb")
+	decode(strings, log, cpu_hz)
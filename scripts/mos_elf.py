@@ -0,0 +1,108 @@
+#!/usr/bin/python
+# read the sections and symbols of a mos program's elf (32 or 64bit, either
+# endian) without needing the toolchain, used by the host side debug tools
+import struct
+import sys
+
+
+class Elf:
+	def __init__(self, filename):
+		self.elf = open(filename, "rb").read()
+		if self.elf[:4] != b"\x7fELF":
+			sys.exit("%s is not an elf" % filename)
+		self.filename = filename
+		self.bits64 = self.elf[4:5] == b"\x02"
+		self.end = "<" if self.elf[5:6] == b"\x01" else ">"
+		if self.bits64:
+			shoff, = struct.unpack(self.end + "Q", self.elf[0x28:0x30])
+			shentsize, shnum, shstrndx = struct.unpack(self.end + "HHH", self.elf[0x3a:0x40])
+			sh_format = self.end + "IIQQQQIIQQ"
+		else:
+			shoff, = struct.unpack(self.end + "I", self.elf[0x20:0x24])
+			shentsize, shnum, shstrndx = struct.unpack(self.end + "HHH", self.elf[0x2e:0x34])
+			sh_format = self.end + "IIIIIIIIII"
+		size = struct.calcsize(sh_format)
+		headers = [struct.unpack(sh_format, self.elf[shoff + k * shentsize:shoff + k * shentsize + size]) for k in range(shnum)]
+		# name, type, flags, addr, offset, size, link
+		self.sections = []
+		for h in headers:
+			self.sections.append({"name": self.string(headers[shstrndx][4], h[0]), "type": h[1], "addr": h[3], "offset": h[4], "size": h[5], "link": h[6]})
+		self._symbols = None
+		self._vectors = None
+
+	def string(self, offset, index):
+		start = offset + index
+		return self.elf[start:self.elf.index(b"\0", start)].decode("latin-1")
+
+	def section(self, name):
+		for s in self.sections:
+			if s["name"] == name:
+				return s
+		return None
+
+	def section_data(self, name):
+		s = self.section(name)
+		if s is None:
+			return None
+		return self.elf[s["offset"]:s["offset"] + s["size"]]
+
+	# the function and object symbols as a sorted list of (addr, size, name),
+	# thumb function addresses have bit 0 cleared
+	def symbols(self):
+		if self._symbols is not None:
+			return self._symbols
+		self._symbols = []
+		symtab = self.section(".symtab")
+		if symtab is None:
+			return self._symbols
+		strtab = self.sections[symtab["link"]]
+		if self.bits64:
+			fmt, entsize = self.end + "IBBHQQ", 24
+		else:
+			fmt, entsize = self.end + "IIIBBH", 16
+		for k in range(symtab["size"] // entsize):
+			e = struct.unpack(fmt, self.elf[symtab["offset"] + k * entsize:symtab["offset"] + (k + 1) * entsize])
+			if self.bits64:
+				name, info, other, shndx, value, size = e
+			else:
+				name, value, size, info, other, shndx = e
+			if info & 0xf not in (1, 2) or shndx == 0:
+				continue	# only objects and functions that are defined
+			if info & 0xf == 2:
+				value &= ~1
+			self._symbols.append((value, size, self.string(strtab["offset"], name)))
+		self._symbols.sort()
+		return self._symbols
+
+	# the symbol an address is in, as name or name+offset (None if it isn't in one)
+	def symbolise(self, addr, offset=False):
+		best = None
+		for s in self.symbols():
+			if s[0] > addr:
+				break
+			if addr < s[0] + max(s[1], 1):
+				best = s
+		if best is None:
+			return None
+		if offset and addr != best[0]:
+			return "%s+0x%x" % (best[2], addr - best[0])
+		return best[2]
+
+
+CORE_EXCEPTIONS = {2: "NMI", 3: "HardFault", 4: "MemManage", 5: "BusFault", 6: "UsageFault",
+	11: "SVC", 12: "DebugMon", 14: "PendSV", 15: "SysTick"}
+
+
+# name of the handler of exception number n from the vector table (elf may be None)
+def isr_name(elf, n):
+	if elf is not None:
+		if elf._vectors is None:
+			data = elf.section_data(".isr_vector") or b""
+			elf._vectors = struct.unpack("<%dI" % (len(data) // 4), data[:len(data) // 4 * 4])
+		if n < len(elf._vectors):
+			name = elf.symbolise(elf._vectors[n] & ~1)
+			if name is not None:
+				return name
+	if n in CORE_EXCEPTIONS:
+		return CORE_EXCEPTIONS[n]
+	return "irq %d" % (n - 16)
@@ -0,0 +1,120 @@
+#!/usr/bin/python
+import struct
+import sys
+import os
+import mos_elf
+
+
+def show_help():
+	print("%s - Turn the samples of the mos profiler (see hal/stm32f4/prof.h) into folded stacks" % sys.argv[0])
+	print("(feed the output to flamegraph.pl or open it in speedscope)\n")
+	print("Usage: %s [-h] [-b <baud>] [-o <folded>] <elf> <samples>" % sys.argv[0])
+	print("  <samples> is a file of captured uart output or a serial port (ie /dev/ttyUSB0, needs pyserial,")
+	print("  stop it with ctrl-c), the folded stacks go to stdout unless -o is given")
+
+
+PROF_MAGIC = 0x50524631
+PROF_BLOCK_SAMPLES = 64
+
+
+def read_blocks(f):
+	buf = b""
+	magic = struct.pack("<I", PROF_MAGIC)
+	while True:
+		more = f.read(256)
+		if not more:
+			return
+		buf += more
+		while True:
+			# sync on the magic (ie started listening part way through a block)
+			k = buf.find(magic)
+			if k < 0:
+				buf = buf[-3:]
+				break
+			buf = buf[k:]
+			if len(buf) < 12:
+				break
+			count, dropped = struct.unpack("<II", buf[4:12])
+			if count > PROF_BLOCK_SAMPLES:
+				buf = buf[4:]
+				continue
+			size = 12 + count * 12
+			if len(buf) < size:
+				break
+			yield dropped, [struct.unpack("<III", buf[12 + k * 12:24 + k * 12]) for k in range(count)]
+			buf = buf[size:]
+
+
+class Folder:
+	def __init__(self, elf):
+		self.elf = elf
+		self.stacks = {}
+		self.names = {}
+		self.samples = 0
+		self.dropped = 0
+
+	def name(self, addr):
+		if addr not in self.names:
+			self.names[addr] = self.elf.symbolise(addr)
+		return self.names[addr]
+
+	def add(self, pc, lr, exception):
+		if exception == 0:
+			stack = ["thread"]
+		else:
+			stack = [mos_elf.isr_name(self.elf, exception)]
+		func = self.name(pc & ~1) or "0x%08x" % pc
+		# lr is only the caller if the function hasn't called anything yet (or
+		# kept it), an EXC_RETURN, an address outside the program or the function
+		# itself says nothing about the caller
+		if lr < 0xffffffe0:
+			caller = self.name((lr & ~1) - 2)
+			if caller is not None and caller != func:
+				stack.append(caller)
+		stack.append(func)
+		key = ";".join(stack)
+		self.stacks[key] = self.stacks.get(key, 0) + 1
+		self.samples += 1
+
+	def write(self, out):
+		for key in sorted(self.stacks):
+			out.write("%s %d\n" % (key, self.stacks[key]))
+
+
+# check args
+args = sys.argv[1:]
+if "-h" in args:
+	show_help()
+	sys.exit(0)
+baud = 115200
+output = None
+while len(args) > 2 and args[0] in ("-b", "-o"):
+	if args[0] == "-b":
+		baud = int(args[1])
+	else:
+		output = args[1]
+	args = args[2:]
+if len(args) != 2:
+	show_help()
+	sys.exit(1)
+if not os.path.exists(args[0]):
+	sys.exit("Unable open elf %s" % args[0])
+if not os.path.exists(args[1]):
+	sys.exit("Unable open samples %s" % args[1])
+
+folder = Folder(mos_elf.Elf(args[0]))
+if args[1].startswith("/dev/"):
+	import serial
+	samples = serial.Serial(args[1], baud)
+else:
+	samples = open(args[1], "rb")
+try:
+	for dropped, block in read_blocks(samples):
+		folder.dropped = dropped
+		for s in block:
+			folder.add(*s)
+except KeyboardInterrupt:
+	pass
+
+folder.write(open(output, "w") if output else sys.stdout)
+sys.stderr.write("%d samples (%d dropped on the target)\n" % (folder.samples, folder.dropped))
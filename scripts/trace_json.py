@@ -0,0 +1,164 @@
+#!/usr/bin/python
+import struct
+import sys
+import os
+import json
+import mos_elf
+
+
+def show_help():
+	print("%s - Convert a mos trace ring (see hal/stm32f4/trace.h) to chrome trace json" % sys.argv[0])
+	print("(open the output in chrome://tracing or ui.perfetto.dev)\n")
+	print("Usage: %s [-h] [-c <cpu_hz>] [-e <elf>] <trace.bin> <trace.json>" % sys.argv[0])
+	print("  <elf> is the program's elf, used to name the isrs, tasks and driver objects")
+
+
+TRACE_MAGIC = 0x54524331
+
+# events (enum trace_event)
+(ISR_ENTER, ISR_EXIT, TASK_START, TASK_END, DMA_START, DMA_DONE,
+ UART_READ, UART_READ_DONE, UART_WRITE, UART_WRITE_DONE, SPIM_XFER, SPIM_DONE,
+ I2C_READ, I2C_READ_DONE, I2C_WRITE, I2C_WRITE_DONE, I2C_ERROR, USER) = range(1, 19)
+EVENT_NAMES = ["", "isr enter", "isr exit", "task start", "task end", "dma start", "dma done",
+	"uart read", "uart read done", "uart write", "uart write done", "spim xfer", "spim done",
+	"i2c read", "i2c read done", "i2c write", "i2c write done", "i2c error", "user"]
+
+# driver operations as async slices keyed by object, start event: (done events, category, name)
+ASYNC = {
+	DMA_START: ((DMA_DONE,), "dma", "dma"),
+	UART_READ: ((UART_READ_DONE,), "uart", "read"),
+	UART_WRITE: ((UART_WRITE_DONE,), "uart", "write"),
+	SPIM_XFER: ((SPIM_DONE,), "spim", "xfer"),
+	I2C_READ: ((I2C_READ_DONE, I2C_ERROR), "i2c", "read"),
+	I2C_WRITE: ((I2C_WRITE_DONE, I2C_ERROR), "i2c", "write"),
+}
+
+# the records in the order they were written, the ring keeps the last size of them
+def read_ring(filename):
+	data = open(filename, "rb").read()
+	if len(data) < 16:
+		sys.exit("%s is too short to be a trace" % filename)
+	magic, size, head, on = struct.unpack("<IIII", data[:16])
+	if magic != TRACE_MAGIC:
+		sys.exit("%s is not a trace (bad magic 0x%08x)" % (filename, magic))
+	if len(data) < 16 + size * 8:
+		sys.exit("%s is truncated (%d of %d records)" % (filename, (len(data) - 16) // 8, size))
+	rec = [struct.unpack("<II", data[16 + k * 8:24 + k * 8]) for k in range(size)]
+	if head > size:
+		first = head % size
+		rec = rec[first:] + rec[:first]
+	else:
+		rec = rec[:head]
+	# a record is zero if it was reserved but not written before the trace stopped
+	return [r for r in rec if r[1] != 0], max(0, head - size)
+
+
+# the 24 bit object trace_obj records for an address, the top nibble of the
+# address over a 2M offset (flash at 0x08000000 packs as nibble 0)
+def pack(addr):
+	return ((addr >> 7) & 0xe00000) | (addr & 0x1fffff)
+
+
+class Names:
+	def __init__(self, elf):
+		self.elf = elf
+		self.low = {}
+		if elf is None:
+			return
+		# the records keep the objects packed into 24 bits (see trace_obj in trace.h)
+		for addr, size, name in elf.symbols():
+			self.low.setdefault(pack(addr), name)
+
+	def isr(self, n):
+		return mos_elf.isr_name(self.elf, n)
+
+	# tasks are recorded by their function pointer, which has the thumb bit set
+	def obj(self, o):
+		return self.low.get(o, self.low.get(o & ~1, "0x%06x" % o))
+
+
+def convert(records, names, cpu_hz):
+	events = []
+	us = 1000000.0 / cpu_hz
+	time = None
+	last = 0
+	isr_depth = 0
+	task_open = False
+	pending = {}	# (category, obj) -> the start events of the open async slices
+	for cycles, what in records:
+		# the cycle count wraps (every ~25s at 168MHz), assume records are never further apart than that
+		if time is None:
+			time = 0
+		else:
+			time += (cycles - last) & 0xffffffff
+		last = cycles
+		ts = time * us
+		event, obj = what >> 24, what & 0xffffff
+
+		if event == ISR_ENTER:
+			events.append({"name": names.isr(obj), "cat": "isr", "ph": "B", "ts": ts, "pid": 0, "tid": "isr"})
+			isr_depth += 1
+		elif event == ISR_EXIT:
+			# the trace may start part way through an isr
+			if isr_depth > 0:
+				events.append({"name": names.isr(obj), "cat": "isr", "ph": "E", "ts": ts, "pid": 0, "tid": "isr"})
+				isr_depth -= 1
+		elif event == TASK_START:
+			events.append({"name": names.obj(obj), "cat": "task", "ph": "B", "ts": ts, "pid": 0, "tid": "tasks"})
+			task_open = True
+		elif event == TASK_END:
+			if task_open:
+				events.append({"name": names.obj(obj), "cat": "task", "ph": "E", "ts": ts, "pid": 0, "tid": "tasks"})
+				task_open = False
+		elif event in ASYNC:
+			done, cat, name = ASYNC[event]
+			e = {"name": "%s %s" % (names.obj(obj), name), "cat": cat, "ph": "b", "ts": ts, "pid": 0, "id": "0x%06x" % obj}
+			events.append(e)
+			pending[(cat, obj)] = e
+		elif event == USER:
+			events.append({"name": "user %d" % obj, "cat": "user", "ph": "i", "s": "g", "ts": ts, "pid": 0, "tid": "tasks"})
+		else:
+			if event == I2C_ERROR:
+				events.append({"name": "%s error" % names.obj(obj), "cat": "i2c", "ph": "i", "s": "g", "ts": ts, "pid": 0, "tid": "isr"})
+			for start, (done, cat, name) in ASYNC.items():
+				if event in done and (cat, obj) in pending:
+					e = dict(pending.pop((cat, obj)))
+					e["ph"] = "e"
+					e["ts"] = ts
+					events.append(e)
+					break
+
+	# close whatever was still running when the trace stopped
+	for k in range(isr_depth):
+		events.append({"ph": "E", "ts": ts, "pid": 0, "tid": "isr"})
+	if task_open:
+		events.append({"ph": "E", "ts": ts, "pid": 0, "tid": "tasks"})
+	return events
+
+
+# check args
+if __name__ == "__main__":
+	args = sys.argv[1:]
+	if "-h" in args:
+		show_help()
+		sys.exit(0)
+	cpu_hz = 168000000
+	elf = None
+	while len(args) > 2 and args[0] in ("-c", "-e"):
+		if args[0] == "-c":
+			cpu_hz = int(args[1])
+		else:
+			if not os.path.exists(args[1]):
+				sys.exit("Unable open elf %s" % args[1])
+			elf = mos_elf.Elf(args[1])
+		args = args[2:]
+	if len(args) != 2:
+		show_help()
+		sys.exit(1)
+	if not os.path.exists(args[0]):
+		sys.exit("Unable open trace %s" % args[0])
+
+	records, lost = read_ring(args[0])
+	events = convert(records, Names(elf), cpu_hz)
+	json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, open(args[1], "w"), indent=0)
+	sys.stdout.write("%d records (%d older records were overwritten)\n" % (len(records), lost))
@@ -0,0 +1,65 @@
+/**
+ * @file crash_utest.c
+ *
+ * @brief unit test the crash dump of the sys hal module
+ *
+ * This test logs a few records (without sending them) and then calls through
+ * a function pointer without the thumb bit set, which faults (INVSTATE). The
+ * crash dump is saved and the cpu resets, the test then finds the crash and
+ * sends the dump out of the uart (921600 baud) and stops. Capture it and
+ * decode it with
+ *
+ *	scripts/crash_decode.py crash_utest.elf crash.bin
+ *
+ * it should show a HardFault with INVSTATE and FORCED set, the pc at
+ * 0x08000100, the lr in crash, main in the stack and the 3 log records.
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+
+
+static struct sys_crash_t crash_dump;
+
+
+void init(void)
+{
+	sys_init();
+	uart_init(&uart_dev);
+}
+
+
+// not inline so it is in the stacked lr
+__attribute__((noinline)) static void crash(void)
+{
+	void (*bad)(void) = (void (*)(void))0x08000100;
+
+	bad();
+}
+
+
+int main(void)
+{
+	uint32_t k;
+
+	init();
+
+	if (sys_get_last_crash(&crash_dump))
+	{
+		uart_write(&uart_dev, &crash_dump, sizeof(crash_dump), NULL, NULL);
+		while (1);
+	}
+
+	log_init(&uart_dev);
+	for (k = 0; k < 3; k++)
+		sys_log("crashing in %u", 3 - k);
+	sys_spin(100);
+	crash();
+
+	return 0;
+}
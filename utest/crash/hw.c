@@ -0,0 +1,54 @@
+/**
+ * @file hw.c
+ *
+ * @brief crash hw file for the stm32f4 (usart1 on pa9/pa10 with dma)
+ *
+ * @see hw.h for instructions to override the defaults
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#include <hal.h>
+
+#if defined STM32F40_41xxx
+
+	#include <stm32f4xx_conf.h>
+	#include <gpio_hw.h>
+	gpio_pin_t gpio_rx_pa10 = {GPIOA, {GPIO_Pin_10,  GPIO_Mode_AF, GPIO_Speed_50MHz, GPIO_OType_PP, GPIO_PuPd_UP}, 7};
+	gpio_pin_t gpio_tx_pa9  = {GPIOA, {GPIO_Pin_9,  GPIO_Mode_AF, GPIO_Speed_50MHz, GPIO_OType_PP, GPIO_PuPd_UP}, 7};
+
+	#include <dma_hw.h>
+	dma_t uart_tx_dma =
+	{
+		.stream = DMA2_Stream7,
+		.channel = DMA_Channel_4,
+	};
+
+	#include <uart_hw.h>
+	uart_t uart_dev =
+	{
+		.channel = USART1,
+
+		.rx = &gpio_rx_pa10,
+		.tx = &gpio_tx_pa9,
+
+		.cfg = {
+			.USART_BaudRate = 921600,
+			.USART_WordLength = USART_WordLength_8b,
+			.USART_StopBits = USART_StopBits_1,
+			.USART_Parity = USART_Parity_No,
+			.USART_Mode = USART_Mode_Tx,
+			.USART_HardwareFlowControl = USART_HardwareFlowControl_None,
+		},
+
+		.tx_dma = &uart_tx_dma,
+	};
+
+#else
+
+	#error "crash not supported on unknown target"
+
+#endif
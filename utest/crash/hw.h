@@ -0,0 +1,21 @@
+/**
+ * @file hw.h
+ *
+ * @brief crash hw file (the uart the crash dump is sent out of)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HW__
+#define __HW__
+
+
+/**
+ * uart the crash dump and the log are sent out of
+ */
+extern uart_t uart_dev;
+
+#endif
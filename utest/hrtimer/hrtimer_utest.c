@@ -0,0 +1,62 @@
+/**
+ * @file hrtimer_utest.c
+ *
+ * @brief unit test the hrtimer hal module
+ *
+ * This test runs a 100us periodic event that toggles tp1 (check for a 5kHz
+ * square wave on a scope) along with a one shot event that keeps re-starting
+ * itself 50us later and counts how late each one fires.
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+
+hrtimer_event_t square, one_shot;
+uint32_t fired = 0;
+uint32_t late_max = 0;
+
+void square_cb(hrtimer_event_t *event, void *param)
+{
+	gpio_toggle_pin(&tp1);
+}
+
+void one_shot_cb(hrtimer_event_t *event, void *param)
+{
+	uint32_t late = hrtimer_get_us(&hrtimer_dev) - event->time;
+
+	if (late > late_max)
+		late_max = late;
+	fired++;
+
+	hrtimer_start_at(&hrtimer_dev, event, event->time + 50, 0, one_shot_cb, param);
+}
+
+void init(void)
+{
+	sys_init();
+	gpio_init_pin(&tp1);
+	hrtimer_init(&hrtimer_dev);
+}
+
+
+int main(void)
+{
+	init();
+
+	hrtimer_start(&hrtimer_dev, &square, 100, 100, square_cb, NULL);
+	hrtimer_start(&hrtimer_dev, &one_shot, 50, 0, one_shot_cb, NULL);
+
+	// after 1s the one shot should have fired ~20000 times
+	sys_spin(1000);
+	hrtimer_cancel(&hrtimer_dev, &one_shot);
+
+	while (1)
+	{}
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file hw.c
+ *
+ * @brief hrtimer hw file for the stm32f4 (a 32bit timer and a debug pin for timing measurements)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#include <hal.h>
+
+#if defined STM32F40_41xxx
+
+	#include <stm32f4xx_conf.h>
+	#include <gpio_hw.h>
+	#include <tmr_hw.h>
+	#include <hrtimer_hw.h>
+	gpio_pin_t tp1 = {GPIOA, {GPIO_Pin_3,  GPIO_Mode_OUT, GPIO_Speed_50MHz, GPIO_OType_PP, GPIO_PuPd_NOPULL}};
+
+	tmr_t hrtimer_tmr =
+	{
+		.tim = TIM5,
+		.stop_on_halt = 1,
+		.preemption_priority = 1,
+	};
+
+	hrtimer_t hrtimer_dev =
+	{
+		.tmr = &hrtimer_tmr,
+		.ch = TIM_Channel_1,
+	};
+
+#else
+
+	#error "hrtimer not supported on unknown target"
+
+#endif
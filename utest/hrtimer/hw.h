@@ -0,0 +1,18 @@
+/**
+ * @file hw.h
+ *
+ * @brief hrtimer hw file for the stm32f4
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HW__
+#define __HW__
+
+extern gpio_pin_t tp1;
+extern hrtimer_t hrtimer_dev;
+
+#endif
@@ -21,11 +21,11 @@
 	// i2c module
 	dma_t i2c_rx_dma = {
 		.channel = DMA1_Channel5,
-		.preemption_priority = 0,
+		.preemption_priority = SYS_LOCK_KERNEL,
 	};
 	dma_t i2c_tx_dma = {
 		.channel = DMA1_Channel4,
-		.preemption_priority = 0,
+		.preemption_priority = SYS_LOCK_KERNEL,
 	};
 	gpio_pin_t i2c_scl_pin = {
 		.port = GPIOA,
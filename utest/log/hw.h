@@ -0,0 +1,21 @@
+/**
+ * @file hw.h
+ *
+ * @brief log hw file (the uart the log is sent out of)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HW__
+#define __HW__
+
+
+/**
+ * uart the log is sent out of
+ */
+extern uart_t uart_dev;
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file log_utest.c
+ *
+ * @brief unit test the log hal module
+ *
+ * This test logs a message every ms and logs how many cycles the last
+ * sys_log took, the log is sent out of the uart (921600 baud). Decode it with
+ *
+ *	scripts/log_decode.py -b 921600 log_utest.elf /dev/ttyUSB0
+ *
+ * the counts should go up by 1 every ms with nothing dropped, and the cycles
+ * per sys_log should stay under 50 (build with OPT=-O2).
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+
+
+void init(void)
+{
+	sys_init();
+	uart_init(&uart_dev);
+	log_init(&uart_dev);
+}
+
+
+int main(void)
+{
+	uint32_t tick, last_tick = 0, count = 0, start, cycles, cycles_max = 0;
+	struct log_stats_t stats;
+
+	init();
+	sys_log("log utest start, %u Hz", sys_clk_freq());
+
+	while (1)
+	{
+		tick = sys_get_tick();
+		if (tick != last_tick)
+		{
+			last_tick = tick;
+
+			start = sys_cycle_stamp();
+			sys_log("count %u", count);
+			cycles = sys_cycle_stamp() - start;
+			if (cycles > cycles_max)
+				cycles_max = cycles;
+			count++;
+
+			if (count % 1000 == 0)
+			{
+				log_get_stats(&stats);
+				sys_log("sys_log took %u cycles (max %u), %u dropped, %u bytes sent", cycles, cycles_max, stats.dropped, stats.sent);
+			}
+		}
+
+		// the drain would normally be a background task
+		log_drain();
+	}
+
+	return 0;
+}
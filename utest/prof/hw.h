@@ -0,0 +1,26 @@
+/**
+ * @file hw.h
+ *
+ * @brief prof hw file (the timer that samples and the uart the samples are sent out of)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HW__
+#define __HW__
+
+
+/**
+ * timer the samples are taken from (at preemption priority SYS_LOCK_KERNEL)
+ */
+extern tmr_t prof_tmr;
+
+/**
+ * uart the samples are sent out of
+ */
+extern uart_t uart_dev;
+
+#endif
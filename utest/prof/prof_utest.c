@@ -0,0 +1,72 @@
+/**
+ * @file prof_utest.c
+ *
+ * @brief unit test the prof hal module
+ *
+ * This test spends 3 times as long in spin_long as it does in spin_short while
+ * the profiler samples at 997Hz, the samples are sent out of the uart (921600
+ * baud). Fold them with
+ *
+ *	scripts/prof_fold.py -b 921600 prof_utest.elf /dev/ttyUSB0 > prof.folded
+ *	flamegraph.pl prof.folded > prof.svg
+ *
+ * thread;main;spin_long should have about 3 times the samples of
+ * thread;main;spin_short with nothing dropped.
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+
+
+static volatile uint32_t spins;
+
+
+// no inline so they show up as functions of their own
+__attribute__((noinline)) static void spin_long(void)
+{
+	uint32_t k;
+
+	for (k = 0; k < 30000; k++)
+		spins++;
+}
+
+
+__attribute__((noinline)) static void spin_short(void)
+{
+	uint32_t k;
+
+	for (k = 0; k < 10000; k++)
+		spins++;
+}
+
+
+void init(void)
+{
+	sys_init();
+	uart_init(&uart_dev);
+	tmr_init(&prof_tmr);
+	prof_init(&prof_tmr, &uart_dev);
+}
+
+
+int main(void)
+{
+	init();
+	prof_start(997);
+
+	while (1)
+	{
+		spin_long();
+		spin_short();
+
+		// the drain would normally be a background task
+		prof_drain();
+	}
+
+	return 0;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file hw.h
+ *
+ * @brief ramfunc hw file (the pin the exti is on and the uart the log is sent out of)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HW__
+#define __HW__
+
+
+/**
+ * pin the edge event is on (pin 2 of a port, held low, the test triggers exti
+ * line 2 in software at preemption priority SYS_LOCK_KERNEL)
+ */
+extern gpio_pin_t gpio_trig;
+
+/**
+ * uart the log is sent out of
+ */
+extern uart_t uart_dev;
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file ramfunc_utest.c
+ *
+ * @brief unit test the isr latency of the ram functions (see ramfunc)
+ *
+ * This test triggers the exti of a pin held low in software and times from the
+ * trigger to the falling edge callback, 1000 times with the flash cache warm
+ * and 1000 times with it flushed first, and logs the min and max cycles every
+ * second out of the uart (921600 baud). Decode it with
+ *
+ *	scripts/log_decode.py -b 921600 ramfunc_utest.elf /dev/ttyUSB0
+ *
+ * Build it as it is and again with the isr's in flash to compare
+ *
+ *	make clean all CONFIG_RAMFUNC=n
+ *
+ * the log says where the exti isr is (0x2xxxxxxx in ram, 0x08xxxxxx in flash).
+ * The cold cache times should be well down in ram and the warm ones about the
+ * same (the flash cache hides the wait states once it is warm).
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+#include <stm32f4xx_conf.h>
+
+#define RUNS (1000)
+
+
+extern void EXTI2_IRQHandler(void);
+
+static volatile uint32_t stop;
+
+
+static void edge(gpio_pin_t *pin, void *param)
+{
+	stop = sys_cycle_stamp();
+}
+
+
+// flush the instruction and data caches of the flash
+static void flush_flash_cache(void)
+{
+	FLASH->ACR &= ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+	FLASH->ACR |= FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+	FLASH->ACR &= ~(FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+	FLASH->ACR |= FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+}
+
+
+// time from the exti trigger to the callback in cycles
+static uint32_t latency(bool flush)
+{
+	uint32_t start;
+
+	if (flush)
+		flush_flash_cache();
+	stop = 0;
+	start = sys_cycle_stamp();
+	EXTI->SWIER = EXTI_Line2;
+	while (stop == 0)
+		;
+	return stop - start;
+}
+
+
+void init(void)
+{
+	sys_init();
+	uart_init(&uart_dev);
+	log_init(&uart_dev);
+	gpio_init_pin(&gpio_trig);
+	gpio_set_falling_edge_event(&gpio_trig, edge, NULL);
+}
+
+
+int main(void)
+{
+	uint32_t tick, last_tick = 0, k, cycles;
+	uint32_t warm_min, warm_max, cold_min, cold_max;
+
+	init();
+	sys_log("ramfunc utest start, %u Hz, exti isr at 0x%08x", sys_clk_freq(), (uint32_t)EXTI2_IRQHandler);
+
+	while (1)
+	{
+		tick = sys_get_tick();
+		if (tick - last_tick >= 1000)
+		{
+			last_tick = tick;
+
+			warm_min = cold_min = 0xffffffff;
+			warm_max = cold_max = 0;
+			for (k = 0; k < RUNS; k++)
+			{
+				cycles = latency(false);
+				if (cycles < warm_min)
+					warm_min = cycles;
+				if (cycles > warm_max)
+					warm_max = cycles;
+
+				cycles = latency(true);
+				if (cycles < cold_min)
+					cold_min = cycles;
+				if (cycles > cold_max)
+					cold_max = cycles;
+			}
+			sys_log("exti to callback, warm %u..%u cycles, cold %u..%u cycles", warm_min, warm_max, cold_min, cold_max);
+		}
+
+		// the drain would normally be a background task
+		log_drain();
+	}
+
+	return 0;
+}
@@ -15,12 +15,9 @@
 
 #include <mos.h>
 
-void task_periodic(uint32_t time, uint32_t ts)
+void task_periodic(void)
 {
 	gpio_toggle_pin(&tp1);
-
-	time += ts;
-	sched_add_task(time, 1, task_periodic, 2, time, ts);
 }
 
 void task3(void)
@@ -93,11 +90,19 @@ int main(void)
 	ret = sched_rm_task(t1);
 	ret = sched_rm_task(t2);
 
-	// run periodic task forever (check for 2ms square wave on scope)
-	start = sys_get_tick();
-	sched_add_task(start + 10, 1, task_periodic, 2, start, 1);
+	// run periodic task forever (check for 2ms square wave on scope), idling
+	// between ticks until the task is due
+	sched_add_periodic(1, 10, 1, task_periodic, 0);
 	while (1)
+	{
+		uint32_t next;
+
 		ret = sched_run_tasks(1);
+		sys_enter_critical_section();
+		if (sched_next_deadline(&next))
+			sys_idle_until(next);
+		sys_leave_critical_section();
+	}
 	
 	return 0;
 }
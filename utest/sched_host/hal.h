@@ -0,0 +1,52 @@
+/**
+ * @file hal.h
+ *
+ * @brief host stand in for the mos hal so the scheduler can be built and
+ * benchmarked on a pc (see sys.c for the host implementation)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HAL__
+#define __HAL__
+
+
+/* hal dependancies */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* hal components (just the system level interface and the driver interfaces the scheduler uses are needed on the host) */
+#include "../../hal/compiler.h"
+#include "../../hal/stm32f4/sys.h"
+#include "../../hal/stm32f4/uart.h"
+#include "../../hal/stm32f4/spim.h"
+
+
+/**
+ * @brief set the time returned by sys_get_tick (host only)
+ * @param tick new system time
+ */
+void host_set_tick(uint32_t tick);
+
+
+/**
+ * @brief hold the cycle counter at 0 so it only moves with host_add_cycles (host only)
+ * @param hold 1 to hold it, 0 to go back to the host clock
+ * @note for the time budget tests, so they don't depend on the speed of the host
+ */
+void host_hold_cycles(int hold);
+
+
+/**
+ * @brief move the held cycle counter on (host only)
+ * @param n cycles to add
+ */
+void host_add_cycles(uint32_t n);
+
+
+#endif
@@ -0,0 +1,858 @@
+/**
+ * @file sched_bench.c
+ *
+ * @brief host benchmark for the sched module
+ *
+ * This checks the scheduler runs late tasks (including tasks posted from an
+ * isr, periodic tasks, sched_run_for batches, coroutines and tasks woken by
+ * events and queues) in the correct order and then
+ * times sched_add_task, sched_rm_task and sched_run_tasks with 8 to 4096
+ * tasks waiting in the queue, so the backends (see SCHED_BACKEND) can be
+ * compared. It also runs a timeout heavy load where time moves on every
+ * round and most tasks are cancelled before they run. The Makefile builds
+ * one binary per backend.
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <hal.h>
+#include <sched/sched.h>
+#include <sched/sched_co.h>
+#include <sched/sched_event.h>
+#include <sched/sched_tq.h>
+
+
+#define MAX_RESIDENT 4096
+#define ROUNDS 2000
+#define BATCH 8
+
+
+#if SCHED_POLICY == SCHED_POLICY_EDF
+static const char *backend_names[] = {"list+e", "heap+e", "wheel+e"};
+#elif SCHED_PROFILE
+static const char *backend_names[] = {"list+p", "heap+p", "wheel+p"};
+#else
+static const char *backend_names[] = {"list", "heap", "wheel"};
+#endif
+
+static uint32_t rnd_state = 0x12345678;
+static uint32_t rnd(void)
+{
+	// xorshift32, deterministic so runs are comparable
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+static int run_log[64];
+static int run_count = 0;
+static void task_log(uint32_t n)
+{
+	run_log[run_count++] = n;
+}
+
+static void task_nop(void)
+{
+}
+
+
+#if SCHED_POLICY == SCHED_POLICY_PRIORITY
+// late tasks must run highest priority first, oldest first for equal priorities
+static int check_order(void)
+{
+	static const struct {uint32_t time; uint8_t priority;} tasks[] =
+	{
+		{105, 1}, {101, 1}, {103, 3}, {102, 3}, {100, 2}, {104, 1}, {200, 9},
+	};
+	static const int expected[] = {3, 2, 4, 1, 5, 0};
+	task_id_t id = 0, reused;
+	int k, n;
+
+	host_set_tick(0);
+	sched_init();
+	run_count = 0;
+	for (k = 0; k < sizeof(tasks)/sizeof(tasks[0]); k++)
+		id = sched_add_task(tasks[k].time, tasks[k].priority, task_log, 1, k);
+
+	host_set_tick(150);
+	n = sched_run_tasks(1);
+	if (n != 6 || run_count != 6)
+		return -1;
+	for (k = 0; k < 6; k++)
+		if (run_log[k] != expected[k])
+			return -1;
+
+	// the task at 200 should still be removable, and only once
+	if (sched_rm_task(id) != 1 || sched_rm_task(id) != 0)
+		return -1;
+
+	// a stale id must not remove the new task that reuses its slot
+	reused = sched_add_task(300, 1, task_log, 1, 0);
+	if (sched_rm_task(id) != 0 || sched_rm_task(reused) != 1)
+		return -1;
+
+	return 0;
+}
+#endif
+
+
+// tasks posted from an isr are queued by the next sched_run_tasks and run in
+// order with the other tasks, posts beyond the ring size are refused
+static int check_post(void)
+{
+	int k;
+
+	host_set_tick(0);
+	sched_init();
+	run_count = 0;
+	sched_add_task(10, 1, task_log, 1, 100);
+	for (k = 0; k < SCHED_POST_SIZE; k++)
+		if (sched_post_from_isr(k < 2 ? 5 : 50, 2 - k % 2, task_log, 1, k) != 1)
+			return -1;
+	if (sched_post_from_isr(5, 1, task_log, 1, 0) != 0)
+		return -1;
+
+	host_set_tick(20);
+	if (sched_run_tasks(1) != 3 || run_log[0] != 0 || run_log[1] != 1 || run_log[2] != 100)
+		return -1;
+
+	// the ring has been drained so it takes posts again
+	if (sched_post_from_isr(5, 1, task_log, 1, 0) != 1)
+		return -1;
+	host_set_tick(50);
+	return sched_run_tasks(1) == SCHED_POST_SIZE - 1 ? 0 : -1;
+}
+
+
+// periodic tasks are released from their ideal release time and skip (and
+// count) any releases missed while they were late
+static int check_periodic(void)
+{
+	static const struct {uint32_t now; int runs;} steps[] =
+	{
+		{4, 0}, {5, 1}, {14, 0}, {16, 1}, {47, 1}, {50, 0}, {55, 1},
+	};
+	task_id_t id;
+	int k;
+
+	host_set_tick(0);
+	sched_init();
+	id = sched_add_periodic(10, 5, 1, task_log, 1, 7);
+	if (id == -1 || sched_add_periodic(0, 5, 1, task_log, 0) != -1)
+		return -1;
+	sched_add_periodic(20, 0, 1, task_nop, 0);
+
+	for (k = 0; k < sizeof(steps)/sizeof(steps[0]); k++)
+	{
+		host_set_tick(steps[k].now);
+		run_count = 0;
+		sched_run_tasks(1);
+		if (run_count != steps[k].runs || (run_count && run_log[0] != 7))
+			return -1;
+	}
+
+	// releases 35 and 45 were missed while the task was late
+	if (sched_get_overruns(id) != 2)
+		return -1;
+
+	// both periodic tasks go and the id is stale
+	if (sched_rm_periodic(NULL) != 2 || sched_get_overruns(id) != -1 || sched_rm_task(id) != 0)
+		return -1;
+	return 0;
+}
+
+
+// idling until sched_next_deadline must wake in time for every task (the wheel
+// may wake early for tasks in its upper levels, but never late)
+#define IDLE_TASKS 64
+static uint32_t idle_time[IDLE_TASKS];
+static int idle_err, idle_runs;
+static void task_idle(uint32_t k)
+{
+	if (sys_get_tick() != idle_time[k])
+		idle_err = 1;
+	idle_runs++;
+}
+
+// idle from deadline to deadline until there are no tasks, returns the wakes
+static int idle_run(void)
+{
+	uint32_t tick;
+	int wakes = 0;
+
+	while (sched_next_deadline(&tick))
+	{
+		if (sys_tick_diff(sys_get_tick(), tick) < 0)
+			return -1;
+		sys_idle_until(tick);
+		sched_run_tasks(1);
+		wakes++;
+	}
+	return wakes;
+}
+
+static int check_idle(void)
+{
+	uint32_t now = 0xffffff00, tick;
+	int k, wakes;
+
+	host_set_tick(now);
+	sched_init();
+	if (sched_next_deadline(&tick) != 0)
+		return -1;
+
+	idle_err = idle_runs = 0;
+	for (k = 0; k < IDLE_TASKS; k++)
+	{
+		idle_time[k] = now + 1 + rnd() % (k % 2 ? 100 : 20000);
+		sched_add_task(idle_time[k], rnd() % 4, task_idle, 1, k);
+	}
+	wakes = idle_run();
+	if (idle_err || idle_runs != IDLE_TASKS || wakes < 0 || wakes > 1000)
+		return -1;
+
+	// a short timeout armed part way through a block, after a longer one is
+	// queued, must not hide the longer one (the wheel has it in level 1 and
+	// the short one in level 0)
+	host_set_tick(0);
+	sched_init();
+	idle_err = idle_runs = 0;
+	idle_time[0] = 70;
+	sched_add_task(idle_time[0], 1, task_idle, 1, 0);
+	host_set_tick(60);
+	sched_run_tasks(1);
+	idle_time[1] = 100;
+	sched_add_task(idle_time[1], 1, task_idle, 1, 1);
+	if (!sched_next_deadline(&tick) || sys_tick_diff(tick, 70) < 0)
+		return -1;
+	wakes = idle_run();
+	if (idle_err || idle_runs != 2 || wakes < 0)
+		return -1;
+
+	// with the wheel parked on a block boundary (128) the cascade of the task
+	// in level 1 is due at the boundary itself, not a block later
+	host_set_tick(60);
+	sched_init();
+	idle_err = idle_runs = 0;
+	idle_time[0] = 130;
+	sched_add_task(idle_time[0], 1, task_idle, 1, 0);
+	host_set_tick(127);
+	sched_run_tasks(1);
+	if (!sched_next_deadline(&tick) || sys_tick_diff(tick, 130) < 0)
+		return -1;
+	wakes = idle_run();
+
+	return (idle_err || idle_runs != 1 || wakes < 0) ? -1 : 0;
+}
+
+
+// sched_run_for runs the late tasks in order and puts back what it has no time
+// for, tasks in the detached batch can still be removed
+static task_id_t run_for_rm_id;
+static void task_run_for(uint32_t n)
+{
+	run_log[run_count++] = n;
+	if (n == 1)
+		sched_rm_task(run_for_rm_id);
+	host_add_cycles(200000);
+}
+
+static int check_run_for(void)
+{
+	static const int expected[] = {0, 1, 3, 4};
+	int k;
+
+	host_set_tick(0);
+	sched_init();
+	run_count = 0;
+	for (k = 0; k < 5; k++)
+		if (k == 2)
+			run_for_rm_id = sched_add_task(5 + k, 1, task_run_for, 1, k);
+		else
+			sched_add_task(5 + k, k < 2 ? 2 : 1, task_run_for, 1, k);
+	host_set_tick(10);
+
+	// no budget still runs a task, then each task takes 200us of a 300us budget
+	host_hold_cycles(1);
+	k = sched_run_for(0) != 1 || sched_run_for(300) != 2 || sched_run_for(100000) != 1;
+	host_hold_cycles(0);
+	if (k)
+		return -1;
+	for (k = 0; k < 4; k++)
+		if (run_log[k] != expected[k])
+			return -1;
+	return sched_run_tasks(1) == 0 ? 0 : -1;
+}
+
+
+// uart writes (ie the profile dump) go to stdout on the host, unless the test
+// makes the uart busy
+static int uart_busy;
+int uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param)
+{
+	if (uart_busy)
+		return -1;
+	fwrite(buf, 1, len, stdout);
+	cb(uart, buf, len, param);
+	return 0;
+}
+
+
+#if SCHED_PROFILE
+// the profile sees every run, how late it was, the queue high water mark and
+// every failed add
+static int check_profile(void)
+{
+	struct sched_profile_t p;
+	struct sched_cb_profile_t cb;
+	int k;
+
+	host_set_tick(0);
+	sched_init();
+	for (k = 0; k < SCHED_MAX_TASKS; k++)
+		sched_add_task(k % 8, 1, task_nop, 0);
+	if (sched_add_task(0, 1, task_nop, 0) != -1 || sched_post_from_isr(7, 1, task_log, 1, 0) != 1)
+		return -1;
+
+	host_set_tick(7);
+	run_count = 0;
+	sched_run_tasks(1);
+	sched_get_profile(&p);
+	if (p.runs != SCHED_MAX_TASKS + 1 || p.used != 0 || p.used_max != SCHED_MAX_TASKS || p.alloc_failures < 2)
+		return -1;
+
+	// the task at 0 ran 7 ticks late (bucket 3 is 4 to 7)
+	if (p.late[3] != SCHED_MAX_TASKS / 8 * 4 || p.late_max != 7)
+		return -1;
+	if (!sched_get_cb_profile(0, &cb) || cb.cb != task_nop || cb.runs != SCHED_MAX_TASKS)
+		return -1;
+
+	// a refused write doesn't leave the dump stuck
+	uart_busy = 1;
+	if (sched_profile_dump(NULL) != 0)
+		return -1;
+	uart_busy = 0;
+	if (sched_profile_dump(NULL) != 1)
+		return -1;
+	sched_profile_reset();
+	sched_get_profile(&p);
+	return (p.runs || sched_get_cb_profile(0, &cb)) ? -1 : 0;
+}
+#endif
+
+
+// a fake uart read that completes when the test calls uart_read_cb (like the
+// uart isr would)
+static uart_read_complete_cb uart_read_cb;
+static void *uart_read_param;
+static int uart_read_busy;
+int uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param)
+{
+	if (uart_read_busy)
+		return -1;
+	uart_read_cb = cb;
+	uart_read_param = param;
+	return 0;
+}
+
+// coroutines carry on from each AWAIT once it completes, a yield lets the
+// other coroutines run first
+struct co_test_t
+{
+	co_t co;
+	int step;
+	uint8_t buf[4];
+};
+static int co_test(co_t *co)
+{
+	struct co_test_t *t = (struct co_test_t *)co;
+
+	CO_BEGIN(co);
+	for (t->step = 1; t->step < 3; t->step++)
+		AWAIT_UART_READ(co, NULL, t->buf, sizeof(t->buf));
+	t->step = co->result;
+	AWAIT_DELAY(co, 5);
+	t->step = 10;
+	CO_YIELD(co);
+	t->step = 11;
+	CO_END(co);
+}
+
+// a read the uart refuses carries on with -1 rather than waiting for good
+static int co_refused(co_t *co)
+{
+	struct co_test_t *t = (struct co_test_t *)co;
+
+	CO_BEGIN(co);
+	AWAIT_UART_READ(co, NULL, t->buf, sizeof(t->buf));
+	t->step = co->result;
+	CO_END(co);
+}
+
+static int check_co(void)
+{
+	struct co_test_t t = {{0}};
+
+	host_set_tick(0);
+	sched_init();
+	co_start(&t.co, co_test, NULL);
+	if (t.step != 0)
+		return -1;
+
+	// the coroutine doesn't count as the one task sched_run_for always runs
+	run_count = 0;
+	sched_add_task(0, 1, task_run_for, 1, 9);
+	host_hold_cycles(1);
+	if (sched_run_for(0) != 2 || t.step != 1 || run_count != 1 || sched_run_tasks(1) != 0)
+		return -1;
+	host_hold_cycles(0);
+
+	// completing the read resumes the coroutine, it waits for the second read
+	uart_read_cb(NULL, t.buf, 4, uart_read_param);
+	if (sched_run_tasks(1) != 1 || t.step != 2)
+		return -1;
+	uart_read_cb(NULL, t.buf, 3, uart_read_param);
+	if (sched_run_tasks(1) != 1 || t.step != 3)
+		return -1;
+
+	// the delay wakes it at 5, then it yields once before it finishes
+	host_set_tick(4);
+	if (sched_run_tasks(1) != 0 || t.step != 3)
+		return -1;
+	host_set_tick(5);
+	if (sched_run_tasks(1) != 2 || t.step != 10)
+		return -1;
+	if (sched_run_tasks(1) != 1 || t.step != 11 || sched_run_tasks(1) != 0)
+		return -1;
+
+	t.step = 0;
+	uart_read_busy = 1;
+	co_start(&t.co, co_refused, NULL);
+	sched_run_tasks(1);
+	sched_run_tasks(1);
+	uart_read_busy = 0;
+	return (t.step == -1 && sched_run_tasks(1) == 0) ? 0 : -1;
+}
+
+
+// tasks woken by an event or a queue run as soon as they are signalled, or with 0 on a timeout
+static uint32_t wait_log[8];
+static int wait_runs;
+static void task_wait(uint32_t arg, uint32_t value)
+{
+	if (wait_runs < 8)
+		wait_log[wait_runs] = (arg << 16) | value;
+	wait_runs++;
+}
+
+static int check_event(void)
+{
+	sched_event_t event;
+	sched_queue_t queue;
+	uint32_t buf[2], item;
+	task_id_t id;
+
+	host_set_tick(0);
+	sched_init();
+	sched_event_init(&event);
+	wait_runs = 0;
+
+	// 1 waits for bit 0 forever, 2 for bit 1 with a timeout and 3 for bit 2 (removed)
+	sched_wait_event(&event, 1, 0, 1, task_wait, 1);
+	sched_wait_event(&event, 2, 10, 2, task_wait, 2);
+	id = sched_wait_event(&event, 4, 0, 1, task_wait, 3);
+	if (sched_run_tasks(1) != 0 || sched_rm_task(id) != 1)
+		return -1;
+
+	// setting bits 0 and 3 wakes 1 straight away, bit 3 stays set as no one has it
+	sched_set_event(&event, 9);
+	if (sched_run_tasks(1) != 1 || wait_log[0] != 0x10001 || event.flags != 8)
+		return -1;
+	sched_wait_event(&event, 8, 0, 1, task_wait, 4);
+	if (sched_run_tasks(1) != 1 || wait_log[1] != 0x40008 || event.flags != 0)
+		return -1;
+
+	// 2 times out
+	host_set_tick(10);
+	sched_set_event(&event, 4);
+	if (sched_run_tasks(1) != 1 || wait_log[2] != 0x20000 || event.flags != 4)
+		return -1;
+
+	// each item wakes one waiter
+	sched_queue_init(&queue, buf, sizeof(buf[0]), 2);
+	sched_wait_queue(&queue, 0, 1, task_wait, 5);
+	sched_wait_queue(&queue, 5, 1, task_wait, 6);
+	item = 7;
+	if (sched_queue_send_from_isr(&queue, &item) != 1 || sched_queue_send(&queue, &item) != 1 || sched_queue_send(&queue, &item) != 0)
+		return -1;
+	if (sched_run_tasks(1) != 2 || wait_log[3] != 0x50001 || wait_log[4] != 0x60002)
+		return -1;
+	if (sched_queue_receive(&queue, &item) != 1 || item != 7 || sched_queue_receive(&queue, &item) != 1 || sched_queue_receive(&queue, &item) != 0)
+		return -1;
+
+	// no tasks are left behind
+	host_set_tick(100);
+	return sched_run_tasks(1) == 0 && wait_runs == 5 ? 0 : -1;
+}
+
+
+// a payload is copied into the task and passed to the callback by pointer
+struct ctx_test_t {uint32_t a; uint16_t b; uint8_t c[10];};
+static struct ctx_test_t ctx_seen;
+static size_t ctx_len;
+static void task_ctx(void *ctx, size_t len)
+{
+	memcpy(&ctx_seen, ctx, len);
+	ctx_len = len;
+}
+
+static int check_ctx(void)
+{
+	struct ctx_test_t ctx = {0x12345678, 0xabcd, "mos sched"};
+	uint8_t big[SCHED_CTX_SIZE + 1] = {0};
+
+	host_set_tick(0);
+	sched_init();
+	memset(&ctx_seen, 0, sizeof(ctx_seen));
+	if (sched_add_task_ctx(1, 1, task_ctx, &ctx, sizeof(ctx)) == -1 || sched_add_task_ctx(1, 1, task_ctx, big, sizeof(big)) != -1)
+		return -1;
+
+	// the callers copy can change once the task is added
+	ctx.a = 0;
+	host_set_tick(1);
+	if (sched_run_tasks(1) != 1 || ctx_len != sizeof(ctx))
+		return -1;
+	ctx.a = 0x12345678;
+	return memcmp(&ctx, &ctx_seen, sizeof(ctx)) == 0 ? 0 : -1;
+}
+
+
+// idle until the next deadline and run the tasks (the wheel can report an
+// earlier deadline than the next task, those wakeups run nothing)
+static int wake(void)
+{
+	uint32_t tick;
+	int n = 0;
+
+	while (n == 0 && sched_next_deadline(&tick))
+	{
+		host_set_tick(tick);
+		n = sched_run_tasks(1);
+	}
+	return n;
+}
+
+// slack tasks run at the earliest window end or along with any task that is due
+// once their window has started
+static int check_slack(void)
+{
+	task_id_t id;
+
+	host_set_tick(0);
+	sched_init();
+	run_count = 0;
+	sched_add_task_slack(10, 90, 1, task_log, 1, 0);
+	sched_add_task(50, 1, task_log, 1, 1);
+	sched_add_task_slack(60, 60, 1, task_log, 1, 2);
+	id = sched_add_task_slack(70, 10, 1, task_log, 1, 3);
+	if (sched_rm_task(id) != 1)
+		return -1;
+
+	// 0 shares the wakeup for 1, 2's window has not started
+	if (wake() != 2 || sys_get_tick() != 50 || run_log[0] != 0 || run_log[1] != 1 || sched_get_saved_wakeups() != 1)
+		return -1;
+	// (the wheel wakes early to cascade, 2 can run then as its window has started)
+	if (wake() != 1 || sys_get_tick() < 60 || sys_get_tick() > 120 || run_log[2] != 2 || sched_get_saved_wakeups() != 1)
+		return -1;
+
+	// overlapping windows wake once at the first window end
+	sched_add_task_slack(300, 100, 1, task_log, 1, 4);
+	sched_add_task_slack(320, 100, 1, task_log, 1, 5);
+	if (wake() != 2 || sys_get_tick() < 320 || sys_get_tick() > 400 || run_log[3] != 4 || run_log[4] != 5 || sched_get_saved_wakeups() != 2)
+		return -1;
+	return wake() == 0 ? 0 : -1;
+}
+
+
+// a user pool holds as many tasks as fit, running out calls the exhaustion hook
+static int exhausted;
+void sched_pool_exhausted(void *callback)
+{
+	exhausted++;
+}
+
+static int check_pool(void)
+{
+	static uint64_t mem[256];
+	struct sched_pool_stats_t stats;
+	int k, n;
+
+	host_set_tick(0);
+	n = sched_init_pool((uint8_t *)mem + 1, sizeof(mem) - 1);
+	if (n <= 0 || n * sizeof(struct task_info_t) > sizeof(mem))
+		return -1;
+
+	exhausted = 0;
+	for (k = 0; k < n; k++)
+		if (sched_add_task(k, 1, task_nop, 0) == -1)
+			return -1;
+	if (sched_add_task(0, 1, task_nop, 0) != -1 || exhausted != 1)
+		return -1;
+	host_set_tick(n / 2);
+	sched_run_tasks(1);
+	sched_get_pool_stats(&stats);
+	if (stats.size != n || stats.used_max != n || stats.used != n - (n / 2 + 1) || stats.failures != 1)
+		return -1;
+
+	// back to the static pool for the other checks
+	return sched_init_pool(NULL, 0) == SCHED_MAX_TASKS ? 0 : -1;
+}
+
+
+#if SCHED_POLICY == SCHED_POLICY_EDF
+// a task that runs for about 20us
+static void task_spin(void)
+{
+	uint32_t start = sys_get_cycles();
+
+	while (sys_get_cycles() - start < 20000);
+}
+
+// late tasks run earliest absolute deadline first whatever their priority and
+// the admission check uses the measured run times
+static int check_edf(void)
+{
+	static const int expected[] = {2, 3, 1, 0};
+	struct sched_edf_task_t set[2] = {{task_spin, 1, 0, 0}, {NULL, 1, 0, 500000}};
+	task_id_t id;
+	uint32_t load;
+	int k;
+
+	host_set_tick(0);
+	sched_init();
+	run_count = 0;
+
+	// deadlines 10, 5, 1 and 4 (the last one is moved up from 12 once it is ready)
+	sched_set_deadline(sched_add_task(0, 9, task_log, 1, 0), 10);
+	sched_set_deadline(sched_add_task(2, 1, task_log, 1, 1), 3);
+	sched_add_task(1, 1, task_log, 1, 2);
+	id = sched_add_task(2, 5, task_log, 1, 3);
+	sched_set_deadline(id, 10);
+	host_set_tick(5);
+	sched_run_for(0);
+	if (run_count != 1 || sched_set_deadline(id, 2) != 1)
+		return -1;
+	if (sched_run_tasks(1) != 3)
+		return -1;
+	for (k = 0; k < 4; k++)
+		if (run_log[k] != expected[k])
+			return -1;
+
+	// a periodic task's deadline is its period
+	sched_add_periodic(2, 0, 1, task_spin, 0);
+	host_set_tick(6);
+	sched_run_tasks(1);
+
+	// one tick is 1e6 cycles on the host, the spin task needs about 2% of it
+	if (sched_edf_admit(set, 2, &load) != 1 || load < 510 || load > 600)
+		return -1;
+	set[1].cycles = 990000;
+	if (sched_edf_admit(set, 2, &load) != 0 || load <= 1000)
+		return -1;
+	set[1].deadline = 0;
+	set[0].cb = task_nop;
+	return sched_edf_admit(set, 1, &load) == 0 ? 0 : -1;
+}
+#endif
+
+
+#if SCHED_POLICY == SCHED_POLICY_PRIORITY
+// random adds, removes and time steps (across the tick wrap) checking every
+// task runs once, only when late, in order and that no late task is left behind
+#define CHECK_TASKS 256
+static struct {task_id_t id; uint32_t time; uint8_t priority; int queued;} check[CHECK_TASKS];
+static uint32_t check_now;
+static int check_err, check_last, check_runs;
+static void task_check(uint32_t k)
+{
+	if (!check[k].queued || sys_tick_diff(check_now, check[k].time) > 0)
+		check_err = 1;
+	if (check_last >= 0 && (check[k].priority > check[check_last].priority ||
+		(check[k].priority == check[check_last].priority && sys_tick_diff(check[check_last].time, check[k].time) < 0)))
+		check_err = 1;
+	check[k].queued = 0;
+	check_last = k;
+	check_runs++;
+}
+
+static int check_random(void)
+{
+	int r, k;
+
+	check_now = 0xffffff00 - 100000;
+	host_set_tick(check_now);
+	sched_init();
+	memset(check, 0, sizeof(check));
+	check_err = 0;
+	check_runs = 0;
+
+	for (r = 0; r < 20000 && !check_err; r++)
+	{
+		k = rnd() % CHECK_TASKS;
+		if (check[k].queued && rnd() % 2)
+		{
+			if (sched_rm_task(check[k].id) != 1)
+				return -1;
+			check[k].queued = 0;
+		}
+		else if (!check[k].queued)
+		{
+			// mostly short delays, some long ones to exercise the wheel levels
+			check[k].time = check_now + (rnd() % 8 ? rnd() % 300 : rnd() % 300000);
+			check[k].priority = rnd() % 4;
+			check[k].id = sched_add_task(check[k].time, check[k].priority, task_check, 1, k);
+			check[k].queued = 1;
+		}
+
+		check_now += rnd() % 50;
+		host_set_tick(check_now);
+		check_last = -1;
+		sched_run_tasks(1);
+		for (k = 0; k < CHECK_TASKS; k++)
+			if (check[k].queued && sys_tick_diff(check_now, check[k].time) <= 0)
+				return -1;
+	}
+
+	return (check_err || check_runs == 0) ? -1 : 0;
+}
+#endif
+
+
+// fill the queue with n tasks that are not due for a long time
+static void fill(int n)
+{
+	int k;
+
+	host_set_tick(0);
+	sched_init();
+	for (k = 0; k < n; k++)
+		sched_add_task(1000 + rnd() % 100000, rnd() % 8, task_nop, 0);
+}
+
+
+static void bench(int n)
+{
+	task_id_t ids[BATCH];
+	uint64_t t0, add_ns = 0, rm_ns = 0, run_ns = 0;
+	uint32_t now = 0;
+	int r, k;
+
+	fill(n);
+
+	// add/remove a batch of tasks amongst the resident tasks
+	for (r = 0; r < ROUNDS; r++)
+	{
+		t0 = now_ns();
+		for (k = 0; k < BATCH; k++)
+			ids[k] = sched_add_task(1000 + rnd() % 100000, rnd() % 8, task_nop, 0);
+		add_ns += now_ns() - t0;
+
+		t0 = now_ns();
+		for (k = 0; k < BATCH; k++)
+			sched_rm_task(ids[BATCH - 1 - k]);
+		rm_ns += now_ns() - t0;
+	}
+
+	// dispatch a late task amongst the resident tasks
+	for (r = 0; r < ROUNDS; r++)
+	{
+		sched_add_task(now, rnd() % 8, task_nop, 0);
+		t0 = now_ns();
+		sched_run_tasks(0);
+		run_ns += now_ns() - t0;
+	}
+
+	printf("%-6s %6d %10.1f %10.1f %10.1f\n", backend_names[SCHED_BACKEND], n,
+		(double)add_ns / (ROUNDS * BATCH), (double)rm_ns / (ROUNDS * BATCH), (double)run_ns / ROUNDS);
+}
+
+
+// keep n timeouts armed, each tick arm a new one and cancel a random one
+// (like per connection protocol timeouts that are mostly cancelled on reply)
+static void bench_timeouts(int n)
+{
+	static task_id_t ids[MAX_RESIDENT];
+	uint64_t t0, ns = 0;
+	uint32_t now = 0;
+	int r, k;
+
+	host_set_tick(now);
+	sched_init();
+	for (k = 0; k < n; k++)
+		ids[k] = sched_add_task(now + 1 + rnd() % 5000, rnd() % 8, task_nop, 0);
+
+	t0 = now_ns();
+	for (r = 0; r < ROUNDS * BATCH; r++)
+	{
+		host_set_tick(++now);
+		k = rnd() % n;
+		sched_rm_task(ids[k]);
+		ids[k] = sched_add_task(now + 1 + rnd() % 5000, rnd() % 8, task_nop, 0);
+		sched_run_tasks(1);
+	}
+	ns = now_ns() - t0;
+
+	printf("%-6s %6d %10.1f\n", backend_names[SCHED_BACKEND], n, (double)ns / (ROUNDS * BATCH));
+}
+
+
+int main(void)
+{
+	int n;
+
+#if SCHED_PROFILE
+	if (check_profile() != 0)
+	{
+		printf("%s: the profile is wrong\n", backend_names[SCHED_BACKEND]);
+		return 1;
+	}
+#endif
+
+	// the order and random checks expect priority order
+#if SCHED_POLICY == SCHED_POLICY_EDF
+	if (check_edf() != 0 || check_post() != 0 || check_periodic() != 0 || check_idle() != 0 || check_run_for() != 0 || check_co() != 0 || check_event() != 0 || check_ctx() != 0 || check_slack() != 0 || check_pool() != 0)
+#else
+	if (check_order() != 0 || check_post() != 0 || check_periodic() != 0 || check_idle() != 0 || check_run_for() != 0 || check_co() != 0 || check_event() != 0 || check_ctx() != 0 || check_slack() != 0 || check_pool() != 0 || check_random() != 0)
+#endif
+	{
+		printf("%s: late tasks ran in the wrong order\n", backend_names[SCHED_BACKEND]);
+		return 1;
+	}
+
+	printf("%-6s %6s %10s %10s %10s\n", "sched", "tasks", "add(ns)", "rm(ns)", "run(ns)");
+	for (n = 8; n <= MAX_RESIDENT; n *= 2)
+		bench(n);
+
+	printf("%-6s %6s %10s\n", "sched", "tasks", "tick(ns)");
+	for (n = 8; n <= MAX_RESIDENT; n *= 2)
+		bench_timeouts(n);
+
+	return 0;
+}
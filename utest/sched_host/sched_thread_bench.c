@@ -0,0 +1,257 @@
+/**
+ * @file sched_thread_bench.c
+ *
+ * @brief host check and benchmark for the sched threads (SCHED_THREADS)
+ *
+ * This checks higher priority threads preempt the running thread, sleeping
+ * threads wake in order, equal priority threads take turns on a yield and a
+ * mutex owner inherits the priority of a higher priority waiter (so a medium
+ * priority thread can't hold off the waiter) and that sched_next_deadline
+ * doesn't idle past a sleeping thread. It then times a yield between two
+ * threads. Switches are only made at kernel calls on the host (see
+ * sched_thread_host.c).
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <hal.h>
+#include <sched/sched.h>
+#include <sched/sched_thread.h>
+
+
+#define STACK_SIZE (65536)
+#define YIELDS (100000)
+
+void host_set_tick(uint32_t tick);
+
+static uint64_t stacks[4][STACK_SIZE / sizeof(uint64_t)];
+static thread_t threads[4];
+static mutex_t mutex;
+static char log_buf[64];
+
+
+// the coroutine uart adapters in sched_co.c link to the uart, there is none here
+int uart_read(uart_t *uart, void *buf, uint16_t len, uart_read_complete_cb cb, void *param)
+{
+	return -1;
+}
+
+int uart_write(uart_t *uart, void *buf, uint16_t len, uart_write_complete_cb cb, void *param)
+{
+	return -1;
+}
+
+
+static void log_add(char c)
+{
+	int n = strlen(log_buf);
+
+	if (n < sizeof(log_buf) - 1)
+	{
+		log_buf[n] = c;
+		log_buf[n + 1] = '\0';
+	}
+}
+
+
+static void thread_log(void *arg)
+{
+	log_add(*(char *)arg);
+}
+
+
+// a thread created with a higher priority runs straight away and ends
+static int check_preempt(void)
+{
+	log_buf[0] = '\0';
+	thread_create(&threads[0], stacks[0], STACK_SIZE, 4, thread_log, "a");
+	log_add('m');
+	return strcmp(log_buf, "am") == 0 && threads[0].state == THREAD_DONE ? 0 : -1;
+}
+
+
+static void thread_sleep_log(void *arg)
+{
+	char *s = (char *)arg;
+
+	thread_sleep(s[1] - '0');
+	log_add(s[0]);
+}
+
+
+// sleepers wake in time order whatever their priority
+static int check_sleep(void)
+{
+	log_buf[0] = '\0';
+	thread_create(&threads[0], stacks[0], STACK_SIZE, 5, thread_sleep_log, "a3");
+	thread_create(&threads[1], stacks[1], STACK_SIZE, 6, thread_sleep_log, "b1");
+	thread_create(&threads[2], stacks[2], STACK_SIZE, 4, thread_sleep_log, "c2");
+	thread_sleep(5);
+	return strcmp(log_buf, "bca") == 0 ? 0 : -1;
+}
+
+
+static void thread_yield_log(void *arg)
+{
+	int k;
+
+	thread_sleep(1);
+	for (k = 0; k < 3; k++)
+	{
+		log_add(*(char *)arg);
+		thread_yield();
+	}
+}
+
+
+// equal priorities take turns
+static int check_yield(void)
+{
+	log_buf[0] = '\0';
+	thread_create(&threads[0], stacks[0], STACK_SIZE, 4, thread_yield_log, "a");
+	thread_create(&threads[1], stacks[1], STACK_SIZE, 4, thread_yield_log, "b");
+	thread_sleep(2);
+	return strcmp(log_buf, "ababab") == 0 ? 0 : -1;
+}
+
+
+static void thread_low(void *arg)
+{
+	mutex_lock(&mutex);
+	mutex_lock(&mutex);
+	thread_sleep(10);
+	log_add('l');
+	mutex_unlock(&mutex);
+	mutex_unlock(&mutex);
+	log_add('L');
+}
+
+
+static void thread_high(void *arg)
+{
+	thread_sleep(5);
+	mutex_lock(&mutex);
+	log_add('h');
+	mutex_unlock(&mutex);
+}
+
+
+static void thread_medium(void *arg)
+{
+	thread_sleep(10);
+	log_add('m');
+}
+
+
+/* low holds the mutex high wants, low and medium wake together at 10, low runs
+ * first at high's priority, hands the mutex to high and then drops back below
+ * medium (without inheritance medium runs first, "mlhL") */
+static int check_inherit(void)
+{
+	log_buf[0] = '\0';
+	mutex_init(&mutex);
+	thread_create(&threads[0], stacks[0], STACK_SIZE, 3, thread_low, NULL);
+	thread_create(&threads[1], stacks[1], STACK_SIZE, 8, thread_high, NULL);
+	thread_create(&threads[2], stacks[2], STACK_SIZE, 5, thread_medium, NULL);
+
+	// high is blocked on the mutex at 6 so low has its priority
+	thread_sleep(6);
+	if (threads[1].state != THREAD_BLOCKED || threads[0].priority != 8 || mutex_unlock(&mutex) != -1)
+		return -1;
+
+	thread_sleep(10);
+	if (threads[0].priority != 3 || mutex.owner != NULL)
+		return -1;
+	return strcmp(log_buf, "lhmL") == 0 ? 0 : -1;
+}
+
+
+static void task_nop(void)
+{
+}
+
+
+// the scheduler must not idle past a sleeping thread, with or without tasks queued
+static int check_deadline(void)
+{
+	uint32_t tick, now = sys_get_tick();
+	task_id_t id;
+	int ret = -1;
+
+	log_buf[0] = '\0';
+	sched_init();
+	thread_create(&threads[0], stacks[0], STACK_SIZE, 4, thread_sleep_log, "a7");
+	if (sched_next_deadline(&tick) != 1 || tick != now + 7)
+		goto done;
+
+	// an earlier task comes first, a later one doesn't
+	id = sched_add_task(now + 3, 1, task_nop, 0);
+	if (sched_next_deadline(&tick) != 1 || tick != now + 3 || !sched_rm_task(id))
+		goto done;
+	id = sched_add_task(now + 20, 1, task_nop, 0);
+	if (sched_next_deadline(&tick) != 1 || tick != now + 7 || !sched_rm_task(id))
+		goto done;
+	ret = 0;
+
+done:
+	thread_sleep(8);
+	return ret == 0 && strcmp(log_buf, "a") == 0 ? 0 : -1;
+}
+
+
+static void thread_yielder(void *arg)
+{
+	int k;
+
+	// wait for the other one to be created
+	thread_sleep(1);
+	for (k = 0; k < YIELDS; k++)
+		thread_yield();
+}
+
+
+// two equal priority threads yield to each other, main only runs again once both have ended
+static void bench_yield(void)
+{
+	struct thread_stats_t stats;
+	uint32_t switches, t0;
+
+	thread_get_stats(&stats);
+	switches = stats.switches;
+	thread_create(&threads[0], stacks[0], STACK_SIZE, 4, thread_yielder, NULL);
+	thread_create(&threads[1], stacks[1], STACK_SIZE, 4, thread_yielder, NULL);
+	t0 = sys_get_cycles();
+	thread_sleep(2);
+	t0 = sys_get_cycles() - t0;
+
+	thread_get_stats(&stats);
+	switches = stats.switches - switches;
+	printf("%-8s %10s %10s %10s\n", "thread", "switches", "avg(ns)", "max(ns)");
+	printf("%-8s %10lu %10.1f %10lu\n", "yield", (unsigned long)switches, (double)t0 / switches,
+		(unsigned long)stats.switch_cycles_max);
+}
+
+
+int main(void)
+{
+	host_set_tick(0);
+	// the sys tick can run before the threads are started
+	thread_tick();
+	thread_init();
+
+	if (check_preempt() != 0 || check_sleep() != 0 || check_yield() != 0 || check_inherit() != 0 ||
+		check_deadline() != 0)
+	{
+		printf("threads ran in the wrong order (%s)\n", log_buf);
+		return 1;
+	}
+
+	bench_yield();
+	return 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file sys.c
+ *
+ * @brief implements the parts of the sys module the scheduler needs on the host
+ *
+ * the tick is set explicitly (see host_set_tick) so tests and benchmarks can
+ * control time (and the cycle counter can be held, see host_hold_cycles),
+ * critical sections and locks are no-ops as the host build is single threaded
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <string.h>
+#include <time.h>
+#include "hal.h"
+
+
+static uint32_t ticks = 0;
+static int cycles_held;
+static uint32_t cycles;
+
+
+void host_set_tick(uint32_t tick)
+{
+	ticks = tick;
+}
+
+
+void host_hold_cycles(int hold)
+{
+	cycles_held = hold;
+	cycles = 0;
+}
+
+
+void host_add_cycles(uint32_t n)
+{
+	cycles += n;
+}
+
+
+void sys_enter_critical_section(void)
+{
+}
+
+
+void sys_leave_critical_section(void)
+{
+}
+
+
+sys_lock_t sys_lock_module(uint8_t ceiling, uint8_t module)
+{
+	return 0;
+}
+
+
+void sys_unlock(sys_lock_t lock)
+{
+}
+
+
+void sys_get_lock_stats(struct sys_lock_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+
+void sys_clear_lock_stats(void)
+{
+}
+
+
+// there is nothing to wait for on the host so just jump the tick to the deadline
+uint32_t sys_idle_until(uint32_t tick)
+{
+	int32_t slept = sys_tick_diff(ticks, tick);
+
+	if (slept <= 0)
+		return 0;
+	ticks = tick;
+	return slept;
+}
+
+
+void sys_get_idle_stats(struct sys_idle_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+
+// the host "cpu" runs at 1GHz so cycles are ns from the monotonic clock
+uint32_t sys_clk_freq(void)
+{
+	return 1000000000;
+}
+
+
+uint32_t sys_get_cycles(void)
+{
+	struct timespec ts;
+
+	if (cycles_held)
+		return cycles;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+
+uint64_t sys_time_us64(void)
+{
+	struct timespec ts;
+
+	if (cycles_held)
+		return cycles;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+
+uint32_t sys_get_tick(void)
+{
+	return ticks;
+}
+
+
+// keep the same wrapping behaviour as the target
+uint32_t sys_abs_tick_diff(uint32_t beginning, uint32_t end)
+{
+	if (end >= beginning)
+		return end - beginning;
+	else
+		return (UINT32_MAX - beginning) + end;
+}
+
+
+int32_t sys_tick_diff(uint32_t t1, uint32_t t2)
+{
+	uint32_t tdiff1 = sys_abs_tick_diff(t1, t2);
+	uint32_t tdiff2 = sys_abs_tick_diff(t2, t1);
+
+	if (tdiff1 < tdiff2)
+		return tdiff1;
+	else
+		return -tdiff2;
+}
+
+
+typedef void (*sys_task)(uint32_t p0, uint32_t p1, uint32_t p2, uint32_t p3);
+void sys_run(void *func, uint8_t argc, uint32_t argv[])
+{
+	sys_task t;
+	if (!func || argc > 4)
+		return;
+
+	t = (sys_task)func;
+	t(argv[0], argv[1], argv[2], argv[3]);
+}
+
+
+void sys_nop(void)
+{
+}
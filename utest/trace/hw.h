@@ -0,0 +1,21 @@
+/**
+ * @file hw.h
+ *
+ * @brief trace hw file (the uart the trace is sent out of)
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+#ifndef __HW__
+#define __HW__
+
+
+/**
+ * uart the trace is sent out of
+ */
+extern uart_t uart_dev;
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file trace_utest.c
+ *
+ * @brief unit test the trace hal module
+ *
+ * This test writes a message out of the uart every 10ms for a second with the
+ * trace running, marking each loop with a user event, then stops the trace and
+ * sends the ring out of the uart (921600 baud). Capture it and convert it with
+ *
+ *	scripts/trace_json.py -e trace_utest.elf trace.bin trace.json
+ *
+ * (the messages come before the ring, strip them up to the "TRC1" magic) the
+ * json should show a uart write every 10ms with its dma and isrs nested inside
+ * it, and the SysTick isr every 1ms.
+ *
+ * @author agent
+ *
+ * @date Oct 2026
+ *
+ */
+
+
+#include <hal.h>
+
+
+static volatile uint8_t busy;
+static uint8_t msg[] = "trace utest\r\n";
+
+
+static void write_done(uart_t *uart, void *buf, uint16_t len, void *param)
+{
+	busy = 0;
+}
+
+
+void init(void)
+{
+	sys_init();
+	uart_init(&uart_dev);
+}
+
+
+int main(void)
+{
+	uint32_t tick, start, count = 0;
+
+	init();
+	trace_start();
+
+	start = sys_get_tick();
+	while (count < 100)
+	{
+		tick = sys_get_tick();
+		if (sys_abs_tick_diff(start, tick) < 10 * count)
+			continue;
+
+		trace_user(count);
+		busy = 1;
+		uart_write(&uart_dev, msg, sizeof(msg) - 1, write_done, NULL);
+		while (busy);
+		count++;
+	}
+
+	trace_stop();
+	busy = 1;
+	trace_send(&uart_dev, write_done);
+	while (busy);
+
+	while (1);
+	return 0;
+}